@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <vector>
+#include "vm.hpp"
+
+/*
+ * Measures the interpreter`s dispatch cost on small loops. Build once per backend and compare, e.g.
+ *
+ *     cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build --target bench_zagros
+ *     cmake -S . -B build-tail -DCMAKE_BUILD_TYPE=Release -DZAGROS_TAIL_CALL_DISPATCH=ON && ...
+ */
+
+/// Number of loop iterations of each workload.
+static const uint32_t ITERATIONS = 10000000;
+
+/// Number of times each workload is run, the fastest run is reported.
+static const int REPEATS = 5;
+
+/**
+ * Appends a word in little endian order.
+ * @param prg The program.
+ * @param value The word.
+ */
+static auto put_word(std::vector<uint8_t> &prg, uint32_t value) -> void {
+  for (int i = 0; i < 4; ++i) {
+    prg.push_back(static_cast<uint8_t>(value >> (i * 8)));
+  }
+}
+
+/**
+ * Builds a loop counting down to 0 that branches back with the immediate `JT`.
+ * @return The program.
+ */
+static auto immediate_loop() -> std::vector<uint8_t> {
+  std::vector<uint8_t> prg = {1, 0, 0, 0}; // 00 LW
+  put_word(prg, ITERATIONS);               // 04
+  prg.insert(prg.end(), {3, 1, 20});       // 08 LB 1, SU
+  prg.insert(prg.end(), {10, 3, 0, 16});   // 11 DU, LB 0, NE
+  prg.insert(prg.end(), {62, 0, 0, 0});    // 15 JT
+  put_word(prg, 8);                        // 19
+  prg.push_back(44);                       // 23 HS
+  return prg;
+}
+
+/**
+ * Builds a loop counting down to 0 that loads its target and branches back with `CJ`.
+ * @return The program.
+ */
+static auto stack_loop() -> std::vector<uint8_t> {
+  std::vector<uint8_t> prg = {1, 0, 0, 0}; // 00 LW
+  put_word(prg, ITERATIONS);               // 04
+  prg.insert(prg.end(), {3, 1, 20});       // 08 LB 1, SU
+  prg.insert(prg.end(), {10, 3, 0, 16});   // 11 DU, LB 0, NE
+  prg.insert(prg.end(), {3, 8, 36, 0});    // 15 LB 8, CJ
+  prg.insert(prg.end(), {0, 0});           // 19
+  prg.push_back(44);                       // 21 HS
+  return prg;
+}
+
+/**
+ * Runs a workload and prints its fastest run.
+ * @param name The name of the workload.
+ * @param prg The program.
+ */
+static auto bench(const char *name, const std::vector<uint8_t> &prg) -> void {
+  uint64_t best_ns = UINT64_MAX;
+  uint64_t retired = 0;
+  for (int i = 0; i < REPEATS; ++i) {
+    VM vm;
+    vm.write_memory(0, prg.data(), prg.size());
+    const auto begin = monotonic_ns();
+    vm.run();
+    const auto elapsed = monotonic_ns() - begin;
+    best_ns = elapsed < best_ns ? elapsed : best_ns;
+    retired = vm.metrics().get_instructions_retired();
+  }
+  std::printf("%-16s %12llu instructions %8.3f ns/instruction\n", name, static_cast<unsigned long long>(retired),
+              static_cast<double>(best_ns) / static_cast<double>(retired));
+}
+
+int main() {
+#if defined(ZAGROS_TAIL_CALL_DISPATCH)
+  std::printf("backend: tail calls\n");
+#elif defined(ZAGROS_REPLICATED_DISPATCH)
+  std::printf("backend: computed goto, replicated dispatch\n");
+#else
+  std::printf("backend: computed goto\n");
+#endif
+  bench("immediate loop", immediate_loop());
+  bench("stack loop", stack_loop());
+  return 0;
+}
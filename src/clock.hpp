@@ -0,0 +1,38 @@
+#ifndef ZAGROS_CLOCK
+#define ZAGROS_CLOCK
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Reads the host`s monotonic clock.
+ * @return The current time in nanoseconds.
+ */
+inline auto monotonic_ns() noexcept -> uint64_t {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Reads a cheap, monotonically increasing cycle counter.
+ * Uses the time stamp counter on x86, the virtual counter on ARM64 and nanoseconds of the steady clock elsewhere.
+ * Values are only meaningful as differences on the same host.
+ * @return The current counter value.
+ */
+inline auto cycle_now() noexcept -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t value;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+  return value;
+#else
+  return monotonic_ns();
+#endif
+}
+
+#endif //ZAGROS_CLOCK
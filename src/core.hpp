@@ -21,6 +21,7 @@
 #include "register.hpp"
 #include "memory.hpp"
 #include "interrupt.hpp"
+#include "exec_trace.hpp"
 
 /**
  * The state of a core of the VM.
@@ -28,9 +29,17 @@
  */
 class Core {
  public:
+  // The state every dispatch reads comes first, so it is packed into the start of the core.
+
   /// The instruction pointer.
   uint32_t ip = 0;
 
+  /// The first memory address of the core`s segment.
+  uint32_t seg_base = 0;
+
+  /// The size of the core`s segment, addresses the core uses are relative to `seg_base` and below it.
+  uint32_t seg_limit = MEMORY_SIZE;
+
   /// Whether the core is active or not.
   bool active = false;
 
@@ -40,6 +49,9 @@ class Core {
   /// The current addrs mode.
   AddressMode addr_mode = DIRECT;
 
+  /// The number of instructions the core retired.
+  uint64_t retired = 0;
+
   /// The arr stack.
   DataStack data;
 
@@ -49,6 +61,60 @@ class Core {
   /// The register bank.
   RegisterBank regs;
 
+  // The state only touched on slow paths comes last.
+
+  /// The last instructions executed by the core.
+  ExecutionTrace trace;
+
+  /// The number of host cycles the core spent paused.
+  uint64_t parked_cycles = 0;
+
+  /// The host cycle the core was last paused at.
+  uint64_t parked_since = 0;
+
+  /// The first memory address of the region the data stack spills into.
+  uint32_t data_spill_base = 0;
+
+  /// The number of cells the data stack can spill, 0 if spilling is disabled.
+  uint32_t data_spill_cells = 0;
+
+  /// The number of cells the data stack spilled.
+  uint32_t data_spilled = 0;
+
+  /// The first memory address of the region the address stack spills into.
+  uint32_t addrs_spill_base = 0;
+
+  /// The number of cells the address stack can spill, 0 if spilling is disabled.
+  uint32_t addrs_spill_cells = 0;
+
+  /// The number of cells the address stack spilled.
+  uint32_t addrs_spilled = 0;
+
+  /**
+   * Translates a range of addresses in the core`s segment to memory addresses.
+   * @param addr The address of the range in the segment.
+   * @param len The length of the range.
+   * @return The memory address of the range, or `MEMORY_SIZE` (never legal for a non empty range)
+   * if the range is outside the segment.
+   */
+  auto translate(size_t addr, size_t len) const noexcept -> size_t {
+    return addr + len <= seg_limit ? seg_base + addr : MEMORY_SIZE;
+  }
+
+  /**
+   * Activates or pauses the core, accounting the time it spends paused.
+   * @param value Whether the core should be active.
+   * @param now The current host cycle.
+   */
+  auto set_active(bool value, uint64_t now) noexcept -> void {
+    if (active && !value) {
+      parked_since = now;
+    } else if (!active && value) {
+      parked_cycles += now - parked_since;
+    }
+    active = value;
+  }
+
   /**
    * Set the core's state as just initialized with current ip.
    * @param init_ip The instruction pointer.
@@ -61,6 +127,8 @@ class Core {
     data.clear();
     addrs.clear();
     regs.clear();
+    data_spilled = 0;
+    addrs_spilled = 0;
   }
 
   /**
@@ -0,0 +1,193 @@
+#ifndef ZAGROS_DISASSEMBLER
+#define ZAGROS_DISASSEMBLER
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "zagros_configuration.h"
+#include "exec_trace.hpp"
+
+/**
+ * Turns Zagros machine code and execution trace dumps into human readable text.
+ */
+class Disassembler {
+ private:
+  /**
+   * Static description of an opcode.
+   */
+  struct OpcodeInfo {
+    /// The two letter mnemonic.
+    const char *name;
+
+    /// The number of bytes the instruction occupies.
+    size_t len;
+
+    /// The offset of the immediate value from the opcode.
+    size_t imm_offset;
+
+    /// The number of bytes of the immediate value.
+    size_t imm_len;
+  };
+
+  /**
+   * Looks up the description of an opcode.
+   * @param opcode The opcode.
+   * @return The description, or `nullptr` if the opcode is unknown.
+   */
+  static auto lookup(uint8_t opcode) noexcept -> const OpcodeInfo * {
+    static const OpcodeInfo table[] = {
+        {"NO", 1, 0, 0}, {"LW", 8, 4, 4}, {"LH", 3, 1, 2}, {"LB", 2, 1, 1},
+        {"FW", 1, 0, 0}, {"FH", 1, 0, 0}, {"FB", 1, 0, 0}, {"SW", 1, 0, 0},
+        {"SH", 1, 0, 0}, {"SB", 1, 0, 0}, {"DU", 1, 0, 0}, {"DR", 1, 0, 0},
+        {"SP", 1, 0, 0}, {"PU", 1, 0, 0}, {"PO", 1, 0, 0}, {"EQ", 1, 0, 0},
+        {"NE", 1, 0, 0}, {"LT", 1, 0, 0}, {"GT", 1, 0, 0}, {"AD", 1, 0, 0},
+        {"SU", 1, 0, 0}, {"MU", 1, 0, 0}, {"DM", 1, 0, 0}, {"MD", 1, 0, 0},
+        {"AN", 1, 0, 0}, {"OR", 1, 0, 0}, {"XO", 1, 0, 0}, {"NT", 1, 0, 0},
+        {"SL", 1, 0, 0}, {"SR", 1, 0, 0}, {"PA", 1, 0, 0}, {"UN", 1, 0, 0},
+        {"RL", 1, 0, 0}, {"CA", 4, 0, 0}, {"CC", 4, 0, 0}, {"JU", 4, 0, 0},
+        {"CJ", 4, 0, 0}, {"RE", 1, 0, 0}, {"CR", 4, 0, 0}, {"SV", 1, 0, 0},
+        {"HI", 1, 0, 0}, {"SI", 1, 0, 0}, {"TI", 1, 0, 0}, {"II", 1, 0, 0},
+        {"HS", 1, 0, 0}, {"IC", 1, 0, 0}, {"AC", 1, 0, 0}, {"PC", 1, 0, 0},
+        {"SC", 1, 0, 0}, {"RR", 1, 0, 0}, {"WR", 1, 0, 0}, {"CP", 1, 0, 0},
+        {"BC", 1, 0, 0}, {"UU", 1, 0, 0}, {"FF", 1, 0, 0}, {"PF", 1, 0, 0},
+        {"BK", 1, 0, 0}, {"HP", 1, 0, 0}, {"AL", 1, 0, 0}, {"FR", 1, 0, 0},
+        {"AR", 1, 0, 0}, {"JI", 8, 4, 4}, {"JT", 8, 4, 4}, {"CI", 8, 4, 4},
+        {"CT", 8, 4, 4}, {"SO", 1, 0, 0}, {"BS", 1, 0, 0}, {"HN", 1, 0, 0},
+        {"HL", 1, 0, 0}, {"HA", 1, 0, 0}, {"HD", 1, 0, 0}, {"DP", 1, 0, 0},
+        {"FI", 1, 0, 0}, {"MM", 1, 0, 0}, {"FT", 1, 0, 0}
+    };
+    if (opcode >= sizeof(table) / sizeof(table[0])) {
+      return nullptr;
+    }
+    return &table[opcode];
+  }
+
+  /**
+   * Reads a little endian value from a byte buffer.
+   * @param bytes The buffer.
+   * @param at The index of the first byte.
+   * @param len The number of bytes to read.
+   * @return The value.
+   */
+  static auto read_le(const uint8_t *bytes, size_t at, size_t len) noexcept -> uint32_t {
+    uint32_t value = 0;
+    for (size_t i = 0; i < len; ++i) {
+      value |= static_cast<uint32_t>(bytes[at + i]) << (8 * i);
+    }
+    return value;
+  }
+
+ public:
+  /**
+   * Gets the two letter mnemonic of an opcode.
+   * @param opcode The opcode.
+   * @return The mnemonic, or `??` if the opcode is unknown.
+   */
+  static auto mnemonic(uint8_t opcode) noexcept -> const char * {
+    const auto info = lookup(opcode);
+    return info == nullptr ? "??" : info->name;
+  }
+
+  /**
+   * Gets the number of bytes an instruction occupies.
+   * @param opcode The opcode.
+   * @return The length of the instruction.
+   */
+  static auto length(uint8_t opcode) noexcept -> size_t {
+    const auto info = lookup(opcode);
+    return info == nullptr ? 1 : info->len;
+  }
+
+  /**
+   * Gets the number of immediate bytes of an instruction and where they start.
+   * @param opcode The opcode.
+   * @return A pair of (offset from the opcode, number of bytes), (0, 0) if the instruction has no immediate.
+   */
+  static auto immediate(uint8_t opcode) noexcept -> std::pair<size_t, size_t> {
+    const auto info = lookup(opcode);
+    if (info == nullptr) {
+      return {0, 0};
+    }
+    return {info->imm_offset, info->imm_len};
+  }
+
+  /**
+   * Disassembles a range of machine code.
+   * @param code The machine code, usually the whole memory.
+   * @param size The size of `code`.
+   * @param begin The address to start at.
+   * @param end The address to stop at (exclusive).
+   * @return One line per instruction.
+   */
+  static auto disassemble(const uint8_t *code, size_t size, size_t begin, size_t end) -> std::string {
+    std::stringstream os;
+    end = std::min(end, size);
+    size_t addr = begin;
+    while (addr < end) {
+      const auto opcode = code[addr];
+      const auto len = length(opcode);
+      const auto imm = immediate(opcode);
+      os << addr << ": " << mnemonic(opcode);
+      if (imm.second > 0 && addr + len <= size) {
+        os << " " << read_le(code, addr + imm.first, imm.second);
+      }
+      os << "\n";
+      addr += len;
+    }
+    return os.str();
+  }
+
+  /**
+   * Decodes a binary execution trace dump produced by `VM::dump_trace`.
+   * @param dump The dump.
+   * @return One line per core header and per traced instruction, oldest first.
+   */
+  static auto decode_trace(const std::vector<uint8_t> &dump) -> std::string {
+    std::stringstream os;
+    if (dump.size() < TRACE_DUMP_MAGIC.size() + 2 ||
+        !std::equal(TRACE_DUMP_MAGIC.begin(), TRACE_DUMP_MAGIC.end(), dump.begin())) {
+      os << "<not an execution trace>\n";
+      return os.str();
+    }
+    const auto version = dump[4];
+    if (version != TRACE_DUMP_VERSION) {
+      os << "<unsupported execution trace version " << static_cast<int>(version) << ">\n";
+      return os.str();
+    }
+    const auto core_count = dump[5];
+    size_t at = 6;
+    for (size_t c = 0; c < core_count; ++c) {
+      if (at + 3 > dump.size()) {
+        os << "<truncated>\n";
+        return os.str();
+      }
+      const auto core_id = dump[at];
+      const auto count = read_le(dump.data(), at + 1, 2);
+      at += 3;
+      os << "core " << static_cast<int>(core_id) << ":\n";
+      for (size_t i = 0; i < count; ++i) {
+        if (at + TRACE_DUMP_ENTRY_SIZE > dump.size()) {
+          os << "<truncated>\n";
+          return os.str();
+        }
+        const auto ip = read_le(dump.data(), at, 4);
+        const auto opcode = dump[at + 4];
+        const auto depth = dump[at + 5];
+        const auto tos = read_le(dump.data(), at + 6, 4);
+        os << "  " << ip << ": " << mnemonic(opcode) << " depth: " << static_cast<int>(depth);
+        if (depth > 0) {
+          os << " tos: " << static_cast<int32_t>(tos);
+        }
+        os << "\n";
+        at += TRACE_DUMP_ENTRY_SIZE;
+      }
+    }
+    return os.str();
+  }
+};
+
+#endif //ZAGROS_DISASSEMBLER
@@ -0,0 +1,91 @@
+#ifndef ZAGROS_DSP
+#define ZAGROS_DSP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "zagros_configuration.h"
+
+// The kernels behind `DP`, `FI` and `MM`. They are written over `uint32_t` (whose wrapping arithmetic is also
+// int32 arithmetic) and `float`, with independent lanes and contiguous inner loops the compiler vectorizes.
+
+/**
+ * Computes the dot product of two arrays. Products are summed in `DSP_LANES` interleaved partial sums,
+ * so float results may round differently than a sequential sum.
+ * @tparam T The element type.
+ * @param a The first array.
+ * @param b The second array.
+ * @param len The number of elements.
+ * @return The dot product.
+ */
+template<typename T>
+inline auto dsp_dot(const T *a, const T *b, size_t len) noexcept -> T {
+  std::array<T, DSP_LANES> sums{};
+  size_t i = 0;
+  for (; i + DSP_LANES <= len; i += DSP_LANES) {
+    for (size_t lane = 0; lane < DSP_LANES; ++lane) {
+      sums[lane] += a[i + lane] * b[i + lane];
+    }
+  }
+  T sum{};
+  for (; i < len; ++i) {
+    sum += a[i] * b[i];
+  }
+  for (const auto lane_sum : sums) {
+    sum += lane_sum;
+  }
+  return sum;
+}
+
+/**
+ * Runs a FIR filter over a window of samples, `out[n] = sum(taps[k] * in[n + tap_count - 1 - k])`.
+ * @tparam T The element type.
+ * @param out The filtered samples, `len` elements.
+ * @param in The window of samples, `len + tap_count - 1` elements.
+ * @param taps The filter`s taps, `tap_count` elements.
+ * @param tap_count The number of taps, at least 1.
+ * @param len The number of filtered samples.
+ */
+template<typename T>
+inline auto dsp_fir(T *out, const T *in, const T *taps, size_t tap_count, size_t len) -> void {
+  // Reversed taps turn each output into a dot product with a contiguous slice of the window.
+  const std::vector<T> reversed(std::reverse_iterator<const T *>(taps + tap_count),
+                                std::reverse_iterator<const T *>(taps));
+  for (size_t n = 0; n < len; ++n) {
+    out[n] = dsp_dot(reversed.data(), in + n, tap_count);
+  }
+}
+
+/**
+ * Multiplies two row major matrices, `c = a * b`. The loops are blocked by `DSP_BLOCK_SIZE` so the block of `b`
+ * being used stays in cache, and the innermost loop runs along rows of `b` and `c`.
+ * @tparam T The element type.
+ * @param c The product, `rows * cols` elements.
+ * @param a The left matrix, `rows * inner` elements.
+ * @param b The right matrix, `inner * cols` elements.
+ * @param rows The number of rows of `a`.
+ * @param inner The number of columns of `a` and rows of `b`.
+ * @param cols The number of columns of `b`.
+ */
+template<typename T>
+inline auto dsp_matrix_multiply(T *c, const T *a, const T *b, size_t rows, size_t inner, size_t cols) noexcept
+-> void {
+  std::fill(c, c + rows * cols, T{});
+  for (size_t kk = 0; kk < inner; kk += DSP_BLOCK_SIZE) {
+    const auto k_end = std::min(kk + DSP_BLOCK_SIZE, inner);
+    for (size_t jj = 0; jj < cols; jj += DSP_BLOCK_SIZE) {
+      const auto j_end = std::min(jj + DSP_BLOCK_SIZE, cols);
+      for (size_t i = 0; i < rows; ++i) {
+        for (size_t k = kk; k < k_end; ++k) {
+          const auto a_ik = a[i * inner + k];
+          for (size_t j = jj; j < j_end; ++j) {
+            c[i * cols + j] += a_ik * b[k * cols + j];
+          }
+        }
+      }
+    }
+  }
+}
+
+#endif //ZAGROS_DSP
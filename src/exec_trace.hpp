@@ -0,0 +1,125 @@
+#ifndef ZAGROS_EXEC_TRACE
+#define ZAGROS_EXEC_TRACE
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "result.hpp"
+#include "cell.hpp"
+#include "zagros_configuration.h"
+#include "snapshot.hpp"
+#include "stack.hpp"
+
+/**
+ * A single executed instruction as recorded in the execution trace.
+ */
+struct TraceEntry {
+  /// The instruction pointer of the instruction.
+  uint32_t ip;
+
+  /// The top of the data stack before the instruction ran.
+  uint32_t tos;
+
+  /// The opcode of the instruction.
+  uint8_t opcode;
+
+  /// The depth of the data stack before the instruction ran.
+  uint8_t depth;
+};
+
+/// Magic bytes at the beginning of a binary execution trace dump.
+static const std::array<uint8_t, 4> TRACE_DUMP_MAGIC = {'Z', 'T', 'R', 'C'};
+
+/// Version of the binary execution trace dump format.
+static const uint8_t TRACE_DUMP_VERSION = 1;
+
+/// Size of a single entry in a binary execution trace dump.
+static const size_t TRACE_DUMP_ENTRY_SIZE = 10;
+
+/**
+ * A ring buffer of the last `EXECUTION_TRACE_SIZE` instructions executed by a core.
+ * The core is the only writer, so recording an instruction is a handful of plain stores and needs no locking.
+ */
+class ExecutionTrace {
+ private:
+  static_assert((EXECUTION_TRACE_SIZE & (EXECUTION_TRACE_SIZE - 1)) == 0,
+                "EXECUTION_TRACE_SIZE must be a power of two.");
+
+  /// The trace`s entries.
+  std::array<TraceEntry, EXECUTION_TRACE_SIZE> arr;
+
+  /// The number of instructions recorded so far.
+  uint32_t head = 0;
+
+ public:
+  /**
+   * Constructor
+   */
+  ExecutionTrace() noexcept: arr(), head(0) {}
+
+  /**
+   * Records an instruction, overwriting the oldest entry when the buffer is full.
+   * @param ip The instruction pointer.
+   * @param opcode The opcode.
+   * @param data The data stack before the instruction runs.
+   */
+  auto record(uint32_t ip, uint8_t opcode, const DataStack &data) noexcept -> void {
+    auto &entry = arr[head & (EXECUTION_TRACE_SIZE - 1)];
+    entry.ip = ip;
+    entry.tos = data.peek().to_uint32();
+    entry.opcode = opcode;
+    entry.depth = static_cast<uint8_t>(data.depth());
+    head += 1;
+  }
+
+  /**
+   * Gets the number of entries currently held by the buffer.
+   * @return The number of entries.
+   */
+  auto size() const noexcept -> size_t {
+    return head < EXECUTION_TRACE_SIZE ? head : EXECUTION_TRACE_SIZE;
+  }
+
+  /**
+   * Gets an entry, counting from the oldest one held by the buffer.
+   * @param i The index of the entry.
+   * @return The entry.
+   */
+  auto at(size_t i) const noexcept -> TraceEntry {
+    const auto first = head - size();
+    return arr[(first + i) & (EXECUTION_TRACE_SIZE - 1)];
+  }
+
+  /**
+   * Clears the trace.
+   */
+  auto clear() noexcept -> void {
+    head = 0;
+  }
+
+  /**
+   * Appends the trace in the binary dump format, oldest entry first.
+   * Each entry is the little endian `ip` (4 bytes), the opcode, the stack depth and the little endian top of stack.
+   * @param core_id The id of the core owning the trace.
+   * @param out The dump to append to.
+   */
+  auto dump(uint8_t core_id, std::vector<uint8_t> &out) const -> void {
+    const auto count = static_cast<uint16_t>(size());
+    out.push_back(core_id);
+    out.push_back(count & 0xFF);
+    out.push_back(count >> 8);
+    for (size_t i = 0; i < count; ++i) {
+      const auto entry = at(i);
+      for (size_t b = 0; b < 4; ++b) {
+        out.push_back((entry.ip >> (8 * b)) & 0xFF);
+      }
+      out.push_back(entry.opcode);
+      out.push_back(entry.depth);
+      for (size_t b = 0; b < 4; ++b) {
+        out.push_back((entry.tos >> (8 * b)) & 0xFF);
+      }
+    }
+  }
+};
+
+#endif //ZAGROS_EXEC_TRACE
@@ -0,0 +1,88 @@
+#ifndef ZAGROS_FFT
+#define ZAGROS_FFT
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * The twiddle factors of the FFT sizes the `FT` instruction was used with, computed on first use of each size.
+ */
+class TwiddleCache {
+ private:
+  /// The twiddles of each power of two size, indexed by log2 of the size, as interleaved (real, imaginary) floats.
+  std::array<std::vector<float>, 32> tables;
+
+ public:
+  /**
+   * Gets the forward twiddles of a size, `exp(-2 * pi * i * k / points)` for `k` below `points / 2`.
+   * @param points The size, a power of two.
+   * @return The twiddles as interleaved (real, imaginary) floats.
+   */
+  auto get(size_t points) -> const float * {
+    auto &table = tables[__builtin_ctzll(points)];
+    if (table.empty() && points > 1) {
+      table.resize(points);
+      // Computed in double precision, so each twiddle is the closest float to the exact value.
+      const auto pi = std::acos(-1.0);
+      for (size_t k = 0; k < points / 2; ++k) {
+        const auto angle = -2.0 * pi * static_cast<double>(k) / static_cast<double>(points);
+        table[k * 2] = static_cast<float>(std::cos(angle));
+        table[k * 2 + 1] = static_cast<float>(std::sin(angle));
+      }
+    }
+    return table.data();
+  }
+};
+
+/**
+ * Transforms an array of complex numbers in place by an iterative radix-2 FFT.
+ * The inverse transform is scaled by `1 / points`, so it undoes the forward one.
+ * @param data The complex numbers as interleaved (real, imaginary) floats.
+ * @param points The number of complex numbers, a power of two.
+ * @param twiddles The forward twiddles of the size.
+ * @param inverse Whether to do the inverse transform.
+ */
+inline auto fft(float *data, size_t points, const float *twiddles, bool inverse) noexcept -> void {
+  // Reorder into bit reversed order, so the butterflies can run in place.
+  for (size_t i = 1, j = 0; i < points; ++i) {
+    auto bit = points >> 1;
+    for (; (j & bit) != 0; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(data[i * 2], data[j * 2]);
+      std::swap(data[i * 2 + 1], data[j * 2 + 1]);
+    }
+  }
+  // The inverse twiddles are the conjugates of the forward ones.
+  const auto sign = inverse ? -1.0f : 1.0f;
+  for (size_t half = 1; half < points; half *= 2) {
+    const auto stride = points / (half * 2);
+    for (size_t start = 0; start < points; start += half * 2) {
+      for (size_t k = 0; k < half; ++k) {
+        const auto w_re = twiddles[k * stride * 2];
+        const auto w_im = sign * twiddles[k * stride * 2 + 1];
+        auto *even = data + (start + k) * 2;
+        auto *odd = data + (start + k + half) * 2;
+        const auto t_re = odd[0] * w_re - odd[1] * w_im;
+        const auto t_im = odd[0] * w_im + odd[1] * w_re;
+        odd[0] = even[0] - t_re;
+        odd[1] = even[1] - t_im;
+        even[0] += t_re;
+        even[1] += t_im;
+      }
+    }
+  }
+  if (inverse) {
+    const auto scale = 1.0f / static_cast<float>(points);
+    for (size_t i = 0; i < points * 2; ++i) {
+      data[i] *= scale;
+    }
+  }
+}
+
+#endif //ZAGROS_FFT
@@ -0,0 +1,116 @@
+#ifndef ZAGROS_FUZZ
+#define ZAGROS_FUZZ
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include "result.hpp"
+#include "cell.hpp"
+#include "zagros_configuration.h"
+#include "vm.hpp"
+
+/**
+ * Runs a guest program on many inputs for coverage guided fuzzing.
+ * The vm is set up once, then reset between inputs by copying back only the memory pages the last input dirtied,
+ * so an execution costs about as much as the guest code it runs.
+ *
+ * Each input is written at `input_addr` as a word holding its length followed by its bytes, longer inputs are cut
+ * to `input_capacity` bytes. Branch instructions record edge coverage into the coverage map, which is either owned
+ * by the harness or an external map such as AFL`s shared memory or a libFuzzer extra counters section:
+ *
+ *     extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+ *       static FuzzHarness harness(make_vm(), INPUT_ADDR, INPUT_CAPACITY, 100000);
+ *       harness.run_one(data, size);
+ *       return 0;
+ *     }
+ */
+class FuzzHarness {
+ private:
+  /// The vm as set up before running any input.
+  VM base;
+
+  /// The vm the inputs are run on.
+  VM vm;
+
+  /// The coverage map owned by the harness.
+  std::array<uint8_t, COVERAGE_MAP_SIZE> own_map;
+
+  /// The address the inputs are written at.
+  uint32_t input_addr;
+
+  /// The maximum number of input bytes passed to the guest.
+  uint32_t input_capacity;
+
+  /// The instruction budget of each input.
+  uint64_t budget;
+
+ public:
+  /**
+   * Constructs a harness.
+   * @param base The vm as set up before running any input.
+   * @param input_addr The address the inputs are written at.
+   * @param input_capacity The maximum number of input bytes passed to the guest.
+   * @param budget The instruction budget of each input, so inputs looping forever are cut short.
+   */
+  FuzzHarness(const VM &base, uint32_t input_addr, uint32_t input_capacity, uint64_t budget) noexcept
+      : base(base), vm(base), own_map{}, input_addr(input_addr), input_capacity(input_capacity), budget(budget) {
+    vm.set_coverage_map(own_map.data());
+  }
+
+  FuzzHarness(const FuzzHarness &) = delete;
+  FuzzHarness &operator=(const FuzzHarness &) = delete;
+
+  /**
+   * Records edge coverage into an external map instead of the harness` own.
+   * @param map The map of `COVERAGE_MAP_SIZE` bytes, must outlive the harness. `nullptr` uses the own map again.
+   */
+  auto set_coverage_map(uint8_t *map) noexcept -> void {
+    vm.set_coverage_map(map == nullptr ? own_map.data() : map);
+  }
+
+  /**
+   * Gets the coverage map owned by the harness.
+   * @return The map.
+   */
+  auto get_coverage_map() const noexcept -> const std::array<uint8_t, COVERAGE_MAP_SIZE> & {
+    return own_map;
+  }
+
+  /**
+   * Clears the coverage map owned by the harness.
+   */
+  auto clear_coverage_map() noexcept -> void {
+    own_map.fill(0);
+  }
+
+  /**
+   * Resets the vm and runs it on an input.
+   * @param data The input.
+   * @param size The size of the input.
+   * @return The error that stopped the vm.
+   */
+  auto run_one(const uint8_t *data, size_t size) noexcept -> std::pair<ZError, Unit> {
+    vm.restore(base);
+    const auto len = static_cast<uint32_t>(size < input_capacity ? size : input_capacity);
+    const auto len_bytes = Cell{len}.to_bytes();
+    const auto len_result = vm.write_memory(input_addr, len_bytes.data(), len_bytes.size());
+    if (std::get<0>(len_result) != ZError::None) {
+      return len_result;
+    }
+    const auto write_result = vm.write_memory(input_addr + len_bytes.size(), data, len);
+    if (std::get<0>(write_result) != ZError::None) {
+      return write_result;
+    }
+    return vm.run_for(budget);
+  }
+
+  /**
+   * Gets the vm the last input ran on, e.g. to inspect it after a crash.
+   * @return The vm.
+   */
+  auto get_vm() noexcept -> VM & {
+    return vm;
+  }
+};
+
+#endif //ZAGROS_FUZZ
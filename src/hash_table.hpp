@@ -0,0 +1,358 @@
+#ifndef ZAGROS_HASH_TABLE
+#define ZAGROS_HASH_TABLE
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include "result.hpp"
+#include "cell.hpp"
+#include "zagros_configuration.h"
+#include "memory.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * The outcome of a hash table lookup.
+ */
+struct HashLookup {
+  /// Whether the key was found.
+  bool found;
+
+  /// The value of the key, 0 if not found.
+  uint32_t value;
+};
+
+/**
+ * A hash table from words to words laid out in guest memory, used by the `HN`, `HL`, `HA` and `HD` instructions.
+ *
+ * The table is open addressed in the style of a Swiss table: a header of a capacity word, a count word and a used
+ * slots word padded to `HASH_TABLE_HEADER_SIZE` bytes, followed by one control byte per slot, followed by the slots
+ * as (key, value) word pairs. A control byte is `EMPTY`, `DELETED` or the low 7 bits of the key`s hash.
+ * Slots are probed in groups of `HASH_TABLE_GROUP_SIZE`, matching a group`s control bytes at once with SSE2
+ * where available, so a lookup usually compares one key.
+ */
+class HashTable {
+ private:
+  /// The control byte of a slot never used.
+  static const uint8_t EMPTY = 0x80;
+
+  /// The control byte of a slot whose key was deleted.
+  static const uint8_t DELETED = 0xFE;
+
+  /// The control bytes of a group.
+  typedef std::array<uint8_t, HASH_TABLE_GROUP_SIZE> Group;
+
+  /**
+   * Mixes the bits of a key, the finalizer of MurmurHash3.
+   * @param key The key.
+   * @return The hash.
+   */
+  static auto hash(uint32_t key) noexcept -> uint32_t {
+    key ^= key >> 16;
+    key *= 0x85EBCA6Bu;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35u;
+    key ^= key >> 16;
+    return key;
+  }
+
+  /**
+   * Finds the control bytes of a group equal to a byte.
+   * @param group The control bytes.
+   * @param byte The byte.
+   * @return A mask with bit i set if control byte i is equal.
+   */
+  static auto match(const Group &group, uint8_t byte) noexcept -> uint32_t {
+#if defined(__SSE2__)
+    const auto ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group.data()));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < HASH_TABLE_GROUP_SIZE; ++i) {
+      mask |= static_cast<uint32_t>(group[i] == byte) << i;
+    }
+    return mask;
+#endif
+  }
+
+  /**
+   * Gets the number of bytes of a table.
+   * @param capacity The number of slots.
+   * @return The number of bytes.
+   */
+  static auto table_size(size_t capacity) noexcept -> size_t {
+    return HASH_TABLE_HEADER_SIZE + capacity + capacity * 8;
+  }
+
+  /**
+   * Checks whether a number of slots is a valid capacity, a power of two of at least one group.
+   * @param capacity The number of slots.
+   * @return Whether the capacity is valid.
+   */
+  static auto valid_capacity(size_t capacity) noexcept -> bool {
+    return capacity >= HASH_TABLE_GROUP_SIZE && (capacity & (capacity - 1)) == 0;
+  }
+
+  /**
+   * Reads a word of a table.
+   * @param mem The memory.
+   * @param addr The address of the word, must be legal.
+   * @return The word.
+   */
+  static auto read_word(const Memory &mem, size_t addr) noexcept -> uint32_t {
+    return std::get<1>(mem.read_bytes<4>(addr)).to_uint32();
+  }
+
+  /**
+   * Reads and checks the capacity of a table.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param limit The memory address past the region the table must be in.
+   * @return The capacity if the table is in the region and well formed, ZError otherwise.
+   */
+  static auto read_capacity(const Memory &mem, size_t addr, size_t limit) noexcept -> std::pair<ZError, uint32_t> {
+    if (addr + HASH_TABLE_HEADER_SIZE > limit) {
+      return {ZError::IllegalMemoryAddress, uint32_t{}};
+    }
+    const auto capacity = read_word(mem, addr);
+    if (!valid_capacity(capacity)) {
+      return {ZError::IllegalOperand, uint32_t{}};
+    }
+    if (addr + table_size(capacity) > limit) {
+      return {ZError::IllegalMemoryAddress, uint32_t{}};
+    }
+    return {ZError::None, capacity};
+  }
+
+  /**
+   * Probes a table for a key.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param capacity The capacity of the table.
+   * @param key The key.
+   * @param free_slot The first empty or deleted slot on the key`s probe sequence, `capacity` if there is none.
+   * @return The slot of the key, `capacity` if not found.
+   */
+  static auto find(const Memory &mem, size_t addr, uint32_t capacity, uint32_t key, uint32_t &free_slot) noexcept
+  -> uint32_t {
+    const auto key_hash = hash(key);
+    const auto tag = static_cast<uint8_t>(key_hash & 0x7F);
+    const auto ctrl_addr = addr + HASH_TABLE_HEADER_SIZE;
+    const auto slots_addr = ctrl_addr + capacity;
+    const auto groups = capacity / HASH_TABLE_GROUP_SIZE;
+    auto group_id = (key_hash >> 7) & (groups - 1);
+    free_slot = capacity;
+    // Triangular probing visits every group once, since the number of groups is a power of two.
+    for (uint32_t step = 1; step <= groups; ++step) {
+      Group group{};
+      mem.read_block(ctrl_addr + group_id * HASH_TABLE_GROUP_SIZE, group.data(), group.size());
+      for (auto mask = match(group, tag); mask != 0; mask &= mask - 1) {
+        const auto slot = group_id * HASH_TABLE_GROUP_SIZE + __builtin_ctz(mask);
+        if (read_word(mem, slots_addr + slot * 8) == key) {
+          return slot;
+        }
+      }
+      const auto empty = match(group, EMPTY);
+      if (free_slot == capacity) {
+        const auto free = empty | match(group, DELETED);
+        if (free != 0) {
+          free_slot = group_id * HASH_TABLE_GROUP_SIZE + __builtin_ctz(free);
+        }
+      }
+      // A key is never stored past an empty slot of its probe sequence.
+      if (empty != 0) {
+        break;
+      }
+      group_id = (group_id + step) & (groups - 1);
+    }
+    return capacity;
+  }
+
+  /**
+   * Reinserts the keys of a table in place, turning the slots of deleted keys back into empty ones.
+   * The control bytes are guest memory, so a key stored twice is only kept once.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param capacity The capacity of the table.
+   */
+  static auto rehash(Memory &mem, size_t addr, uint32_t capacity) noexcept -> void {
+    const auto ctrl_addr = addr + HASH_TABLE_HEADER_SIZE;
+    const auto slots_addr = ctrl_addr + capacity;
+    // Mark the keys to reinsert as deleted and the deleted slots as empty, the control bytes of keys have the high
+    // bit clear.
+    for (size_t slot = 0; slot < capacity; ++slot) {
+      const auto ctrl = std::get<1>(mem.read_bytes<1>(ctrl_addr + slot)).to_uint32();
+      mem.write_bytes<1>(ctrl_addr + slot, Cell{static_cast<uint32_t>((ctrl & 0x80) == 0 ? DELETED : EMPTY)});
+    }
+    // Move each key to its first empty or deleted slot, swapping with a key still to reinsert if needed.
+    uint32_t count = 0;
+    for (uint32_t slot = 0; slot < capacity; ++slot) {
+      if (std::get<1>(mem.read_bytes<1>(ctrl_addr + slot)).to_uint32() != DELETED) {
+        continue;
+      }
+      const auto key = read_word(mem, slots_addr + slot * 8);
+      uint32_t free_slot;
+      if (find(mem, addr, capacity, key, free_slot) != capacity || free_slot == capacity) {
+        // The key was reinserted already.
+        mem.write_bytes<1>(ctrl_addr + slot, Cell{static_cast<uint32_t>(EMPTY)});
+        continue;
+      }
+      count += 1;
+      const auto tag = Cell{hash(key) & 0x7F};
+      if (free_slot == slot) {
+        mem.write_bytes<1>(ctrl_addr + slot, tag);
+        continue;
+      }
+      const auto value = read_word(mem, slots_addr + slot * 8 + 4);
+      const auto moved = std::get<1>(mem.read_bytes<1>(ctrl_addr + free_slot)).to_uint32() == DELETED;
+      if (moved) {
+        // Swap in the key to reinsert and look at this slot again.
+        mem.write_bytes<4>(slots_addr + slot * 8, Cell{read_word(mem, slots_addr + free_slot * 8)});
+        mem.write_bytes<4>(slots_addr + slot * 8 + 4, Cell{read_word(mem, slots_addr + free_slot * 8 + 4)});
+        slot -= 1;
+      } else {
+        mem.write_bytes<1>(ctrl_addr + slot, Cell{static_cast<uint32_t>(EMPTY)});
+      }
+      mem.write_bytes<1>(ctrl_addr + free_slot, tag);
+      mem.write_bytes<4>(slots_addr + free_slot * 8, Cell{key});
+      mem.write_bytes<4>(slots_addr + free_slot * 8 + 4, Cell{value});
+    }
+    mem.write_bytes<4>(addr + 4, Cell{count});
+    mem.write_bytes<4>(addr + 8, Cell{count});
+  }
+
+ public:
+  /**
+   * Creates an empty table.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param capacity The number of slots, a power of two of at least `HASH_TABLE_GROUP_SIZE`.
+   * @param limit The memory address past the region the table must be in.
+   * @return Unit if successful, `IllegalOperand` if the capacity is invalid, ZError otherwise.
+   */
+  static auto init(Memory &mem, size_t addr, uint32_t capacity, size_t limit) noexcept -> std::pair<ZError, Unit> {
+    if (!valid_capacity(capacity)) {
+      return {ZError::IllegalOperand, Unit{}};
+    }
+    if (addr + table_size(capacity) > limit) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    mem.write_bytes<4>(addr, Cell{capacity});
+    mem.write_bytes<4>(addr + 4, Cell{uint32_t{0}});
+    mem.write_bytes<4>(addr + 8, Cell{uint32_t{0}});
+    for (size_t i = 0; i < capacity; ++i) {
+      mem.write_bytes<1>(addr + HASH_TABLE_HEADER_SIZE + i, Cell{static_cast<uint32_t>(EMPTY)});
+    }
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Looks up a key.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param key The key.
+   * @param limit The memory address past the region the table must be in.
+   * @return Whether the key was found and its value, ZError if the table is malformed.
+   */
+  static auto lookup(const Memory &mem, size_t addr, uint32_t key, size_t limit) noexcept
+  -> std::pair<ZError, HashLookup> {
+    const auto cap_result = read_capacity(mem, addr, limit);
+    const auto capacity = std::get<1>(cap_result);
+    if (std::get<0>(cap_result) != ZError::None) {
+      return {std::get<0>(cap_result), HashLookup{false, 0}};
+    }
+    uint32_t free_slot;
+    const auto slot = find(mem, addr, capacity, key, free_slot);
+    if (slot == capacity) {
+      return {ZError::None, HashLookup{false, 0}};
+    }
+    const auto value = read_word(mem, addr + HASH_TABLE_HEADER_SIZE + capacity + slot * 8 + 4);
+    return {ZError::None, HashLookup{true, value}};
+  }
+
+  /**
+   * Inserts a key or replaces its value.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param key The key.
+   * @param value The value.
+   * @param limit The memory address past the region the table must be in.
+   * @return Unit if successful, `OutOfMemory` if the table is full, ZError if it is malformed.
+   */
+  static auto insert(Memory &mem, size_t addr, uint32_t key, uint32_t value, size_t limit) noexcept
+  -> std::pair<ZError, Unit> {
+    const auto cap_result = read_capacity(mem, addr, limit);
+    const auto capacity = std::get<1>(cap_result);
+    if (std::get<0>(cap_result) != ZError::None) {
+      return {std::get<0>(cap_result), Unit{}};
+    }
+    const auto slots_addr = addr + HASH_TABLE_HEADER_SIZE + capacity;
+    uint32_t free_slot;
+    auto slot = find(mem, addr, capacity, key, free_slot);
+    if (slot == capacity) {
+      // Keep empty slots around, so probe sequences stay short and end.
+      const auto max_used = capacity - capacity / 8;
+      if (free_slot != capacity
+          && std::get<1>(mem.read_bytes<1>(addr + HASH_TABLE_HEADER_SIZE + free_slot)).to_uint32() == EMPTY
+          && read_word(mem, addr + 8) + 1 > max_used && read_word(mem, addr + 4) < max_used) {
+        // Deleted keys used up the empty slots, rehash to get them back.
+        rehash(mem, addr, capacity);
+        find(mem, addr, capacity, key, free_slot);
+      }
+      if (free_slot == capacity) {
+        return {ZError::OutOfMemory, Unit{}};
+      }
+      slot = free_slot;
+      const auto ctrl_addr = addr + HASH_TABLE_HEADER_SIZE + slot;
+      const auto used = read_word(mem, addr + 8);
+      if (std::get<1>(mem.read_bytes<1>(ctrl_addr)).to_uint32() == EMPTY) {
+        if (used + 1 > max_used) {
+          return {ZError::OutOfMemory, Unit{}};
+        }
+        mem.write_bytes<4>(addr + 8, Cell{used + 1});
+      }
+      mem.write_bytes<1>(ctrl_addr, Cell{hash(key) & 0x7F});
+      mem.write_bytes<4>(slots_addr + slot * 8, Cell{key});
+      mem.write_bytes<4>(addr + 4, Cell{read_word(mem, addr + 4) + 1});
+    }
+    mem.write_bytes<4>(slots_addr + slot * 8 + 4, Cell{value});
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Deletes a key.
+   * @param mem The memory.
+   * @param addr The address of the table.
+   * @param key The key.
+   * @param limit The memory address past the region the table must be in.
+   * @return Whether the key was found, ZError if the table is malformed.
+   */
+  static auto remove(Memory &mem, size_t addr, uint32_t key, size_t limit) noexcept -> std::pair<ZError, bool> {
+    const auto cap_result = read_capacity(mem, addr, limit);
+    const auto capacity = std::get<1>(cap_result);
+    if (std::get<0>(cap_result) != ZError::None) {
+      return {std::get<0>(cap_result), false};
+    }
+    uint32_t free_slot;
+    const auto slot = find(mem, addr, capacity, key, free_slot);
+    if (slot == capacity) {
+      return {ZError::None, false};
+    }
+    // No probe sequence ever passed a group with an empty slot, so the slot can be empty again instead of deleted.
+    const auto ctrl_addr = addr + HASH_TABLE_HEADER_SIZE;
+    Group group{};
+    mem.read_block(ctrl_addr + slot / HASH_TABLE_GROUP_SIZE * HASH_TABLE_GROUP_SIZE, group.data(), group.size());
+    if (match(group, EMPTY) != 0) {
+      mem.write_bytes<1>(ctrl_addr + slot, Cell{static_cast<uint32_t>(EMPTY)});
+      mem.write_bytes<4>(addr + 8, Cell{read_word(mem, addr + 8) - 1});
+    } else {
+      mem.write_bytes<1>(ctrl_addr + slot, Cell{static_cast<uint32_t>(DELETED)});
+    }
+    mem.write_bytes<4>(addr + 4, Cell{read_word(mem, addr + 4) - 1});
+    return {ZError::None, true};
+  }
+};
+
+#endif //ZAGROS_HASH_TABLE
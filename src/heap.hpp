@@ -0,0 +1,209 @@
+#ifndef ZAGROS_HEAP
+#define ZAGROS_HEAP
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include "result.hpp"
+#include "cell.hpp"
+#include "zagros_configuration.h"
+#include "memory.hpp"
+
+/**
+ * A guest heap managing a region of memory, used by the `HP`, `AL`, `FR` and `AR` instructions.
+ *
+ * In size class mode blocks are powers of two from `1 << HEAP_MIN_BLOCK_BITS` bytes, each with a 4 byte header
+ * holding its size class. Freed blocks go to a free list per size class, the next pointer kept in the block itself,
+ * and allocation takes from the free list or bumps the top of the heap.
+ * In arena mode allocation only bumps the top of the heap, freeing does nothing and everything is released at once
+ * by `reset`, which suits per request allocation. `reset` releases everything in size class mode too.
+ */
+class Heap {
+ private:
+  /// Marks the header of an allocated block, the low byte holds the size class.
+  static const uint32_t USED_MAGIC = 0x5A470000;
+
+  /// Marks the header of a freed block, the low byte holds the size class.
+  static const uint32_t FREE_MAGIC = 0x5A460000;
+
+  /// The first memory address of the region.
+  uint32_t begin = 0;
+
+  /// The memory address past the region.
+  uint32_t end = 0;
+
+  /// The memory address past the highest block handed out.
+  uint32_t top = 0;
+
+  /// Whether the heap is in arena mode.
+  bool arena = false;
+
+  /// The first free block of each size class, 0 if none.
+  std::array<uint32_t, HEAP_SIZE_CLASS_COUNT> free_lists{};
+
+  /**
+   * Gets the size class of an allocation.
+   * @param size The requested size.
+   * @return The size class, `HEAP_SIZE_CLASS_COUNT` if the size is too large.
+   */
+  static auto size_class(uint32_t size) noexcept -> uint32_t {
+    const auto needed = static_cast<uint64_t>(size) + 4;
+    uint32_t cls = 0;
+    while (cls < HEAP_SIZE_CLASS_COUNT && (uint64_t{1} << (cls + HEAP_MIN_BLOCK_BITS)) < needed) {
+      cls += 1;
+    }
+    return cls;
+  }
+
+  /**
+   * Reads a word the heap keeps in memory.
+   * @param mem The memory.
+   * @param addr The memory address of the word.
+   * @return The word.
+   */
+  static auto read_word(const Memory &mem, uint32_t addr) noexcept -> uint32_t {
+    return std::get<1>(mem.read_bytes<4>(addr)).to_uint32();
+  }
+
+  /**
+   * Writes a word the heap keeps in memory. Doesn`t count as a guest write for watchpoints.
+   * @param mem The memory.
+   * @param addr The memory address of the word.
+   * @param value The word.
+   */
+  static auto write_word(Memory &mem, uint32_t addr, uint32_t value) noexcept -> void {
+    const auto bytes = Cell{value}.to_bytes();
+    mem.write_block(addr, bytes.data(), bytes.size());
+  }
+
+  /**
+   * Checks whether a block taken from a free list is a freed block of a size class. The next pointers live in guest
+   * memory, so a guest may have overwritten them.
+   * @param mem The memory.
+   * @param addr The memory address of the block.
+   * @param cls The size class of the free list.
+   * @return Whether the block lies on a block boundary below the top of the heap and has a free header of the class.
+   */
+  auto is_free_block(const Memory &mem, uint32_t addr, uint32_t cls) const noexcept -> bool {
+    if (addr < begin + 4 || addr >= top) {
+      return false;
+    }
+    const auto block = addr - 4;
+    const auto block_size = uint32_t{1} << (cls + HEAP_MIN_BLOCK_BITS);
+    if ((block - begin) % (uint32_t{1} << HEAP_MIN_BLOCK_BITS) != 0 || block_size > top - block) {
+      return false;
+    }
+    return read_word(mem, block) == (FREE_MAGIC | cls);
+  }
+
+ public:
+  /**
+   * Manages a region of memory, releasing everything allocated before.
+   * @param region_begin The first memory address of the region.
+   * @param size The size of the region, the region must be in memory.
+   * @param arena_mode Whether to use arena mode.
+   */
+  auto init(uint32_t region_begin, uint32_t size, bool arena_mode) noexcept -> void {
+    begin = region_begin;
+    end = region_begin + size;
+    arena = arena_mode;
+    reset();
+  }
+
+  /**
+   * Allocates a block.
+   * @param mem The memory.
+   * @param size The number of bytes to allocate.
+   * @return The memory address of the block if successful, `OutOfMemory` if the heap is full,
+   * `IllegalMemoryAddress` if the free list was overwritten.
+   */
+  auto allocate(Memory &mem, uint32_t size) noexcept -> std::pair<ZError, uint32_t> {
+    if (arena) {
+      // Bump allocate 4 byte aligned blocks without headers.
+      const auto needed = (static_cast<uint64_t>(size) + 3) & ~uint64_t{3};
+      if (top + needed > end) {
+        return {ZError::OutOfMemory, uint32_t{}};
+      }
+      const auto addr = top;
+      top += static_cast<uint32_t>(needed);
+      return {ZError::None, addr};
+    }
+
+    const auto cls = size_class(size);
+    if (cls >= HEAP_SIZE_CLASS_COUNT) {
+      return {ZError::OutOfMemory, uint32_t{}};
+    }
+    uint32_t block;
+    if (free_lists[cls] != 0) {
+      // Take the first free block of the class.
+      const auto addr = free_lists[cls];
+      if (!is_free_block(mem, addr, cls)) {
+        return {ZError::IllegalMemoryAddress, uint32_t{}};
+      }
+      free_lists[cls] = read_word(mem, addr);
+      block = addr - 4;
+    } else {
+      // Bump the top of the heap.
+      const auto block_size = uint32_t{1} << (cls + HEAP_MIN_BLOCK_BITS);
+      if (static_cast<uint64_t>(top) + block_size > end) {
+        return {ZError::OutOfMemory, uint32_t{}};
+      }
+      block = top;
+      top += block_size;
+    }
+    write_word(mem, block, USED_MAGIC | cls);
+    return {ZError::None, block + 4};
+  }
+
+  /**
+   * Frees a block. Does nothing in arena mode.
+   * @param mem The memory.
+   * @param addr The memory address of the block.
+   * @return Unit if the block was allocated, `IllegalMemoryAddress` otherwise, e.g. for a double free.
+   */
+  auto free(Memory &mem, uint32_t addr) noexcept -> std::pair<ZError, Unit> {
+    if (arena) {
+      return {ZError::None, Unit{}};
+    }
+    if (addr < begin + 4 || addr >= top) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    const auto header = read_word(mem, addr - 4);
+    const auto cls = header & 0xFF;
+    if ((header & ~uint32_t{0xFF}) != USED_MAGIC || cls >= HEAP_SIZE_CLASS_COUNT) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    write_word(mem, addr - 4, FREE_MAGIC | cls);
+    write_word(mem, addr, free_lists[cls]);
+    free_lists[cls] = addr;
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Releases everything allocated at once.
+   */
+  auto reset() noexcept -> void {
+    top = begin;
+    free_lists.fill(0);
+  }
+
+  /**
+   * Checks whether the region lies in a range of memory.
+   * @param range_begin The first memory address of the range.
+   * @param range_end The memory address past the range.
+   * @return Whether the region lies in the range.
+   */
+  auto is_inside(uint64_t range_begin, uint64_t range_end) const noexcept -> bool {
+    return begin >= range_begin && end <= range_end;
+  }
+
+  /**
+   * Gets the number of bytes between the beginning of the region and the highest block handed out.
+   * @return The number of bytes.
+   */
+  auto get_used() const noexcept -> uint32_t {
+    return top - begin;
+  }
+};
+
+#endif //ZAGROS_HEAP
@@ -0,0 +1,155 @@
+#ifndef ZAGROS_HISTOGRAM
+#define ZAGROS_HISTOGRAM
+
+#include <array>
+#include <cstdint>
+
+/**
+ * A log-linear latency histogram in the style of HdrHistogram.
+ * Every power of two range is split into `SUB_BUCKETS` linear buckets, so recorded values keep
+ * about 12% precision over the whole 64 bit range while recording stays a handful of instructions.
+ */
+class LatencyHistogram {
+ public:
+  /// Number of bits of each value kept exactly.
+  static const uint32_t SUB_BUCKET_BITS = 3;
+
+  /// Number of linear buckets per power of two.
+  static const uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+  /// Number of buckets.
+  static const uint32_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+ private:
+  /// The number of values recorded in each bucket.
+  std::array<uint32_t, BUCKET_COUNT> buckets;
+
+  /// The number of recorded values.
+  uint64_t count = 0;
+
+  /// The largest recorded value.
+  uint64_t max = 0;
+
+  /**
+   * Gets the index of the most significant set bit.
+   * @param value A non zero value.
+   * @return The index of the bit.
+   */
+  static auto msb(uint64_t value) noexcept -> uint32_t {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+    uint32_t bit = 0;
+    while (value >>= 1) {
+      bit += 1;
+    }
+    return bit;
+#endif
+  }
+
+  /**
+   * Gets the bucket a value is recorded in.
+   * @param value The value.
+   * @return The index of the bucket.
+   */
+  static auto bucket_of(uint64_t value) noexcept -> uint32_t {
+    if (value < SUB_BUCKETS) {
+      return static_cast<uint32_t>(value);
+    }
+    const auto exp = msb(value);
+    const auto sub = static_cast<uint32_t>(value >> (exp - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exp - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+  }
+
+  /**
+   * Gets the largest value recorded in a bucket.
+   * @param bucket The index of the bucket.
+   * @return The value.
+   */
+  static auto highest_of(uint32_t bucket) noexcept -> uint64_t {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    const auto exp = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const auto sub = bucket % SUB_BUCKETS;
+    const auto lowest = static_cast<uint64_t>(SUB_BUCKETS + sub) << (exp - SUB_BUCKET_BITS);
+    return lowest + ((uint64_t{1} << (exp - SUB_BUCKET_BITS)) - 1);
+  }
+
+ public:
+  /**
+   * Constructs an empty histogram.
+   */
+  LatencyHistogram() noexcept: buckets{}, count(0), max(0) {}
+
+  /**
+   * Records a value.
+   * @param value The value.
+   */
+  auto record(uint64_t value) noexcept -> void {
+    buckets[bucket_of(value)] += 1;
+    count += 1;
+    max = value > max ? value : max;
+  }
+
+  /**
+   * Gets the number of recorded values.
+   * @return The number of recorded values.
+   */
+  auto get_count() const noexcept -> uint64_t {
+    return count;
+  }
+
+  /**
+   * Gets the largest recorded value.
+   * @return The largest recorded value, 0 if nothing is recorded.
+   */
+  auto get_max() const noexcept -> uint64_t {
+    return max;
+  }
+
+  /**
+   * Gets the value at a percentile.
+   * @param percentile The percentile in (0, 100].
+   * @return The highest value equivalent to the value at the percentile, 0 if nothing is recorded.
+   */
+  auto percentile(double percentile) const noexcept -> uint64_t {
+    if (count == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count) + 0.5);
+    rank = rank == 0 ? 1 : rank;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        const auto highest = highest_of(i);
+        return highest < max ? highest : max;
+      }
+    }
+    return max;
+  }
+
+  /**
+   * Adds the values recorded in another histogram.
+   * @param rhs The other histogram.
+   */
+  auto merge(const LatencyHistogram &rhs) noexcept -> void {
+    for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+      buckets[i] += rhs.buckets[i];
+    }
+    count += rhs.count;
+    max = rhs.max > max ? rhs.max : max;
+  }
+
+  /**
+   * Clears the histogram.
+   */
+  auto clear() noexcept -> void {
+    buckets.fill(0);
+    count = 0;
+    max = 0;
+  }
+};
+
+#endif //ZAGROS_HISTOGRAM
@@ -11,6 +11,7 @@
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <vector>
 #include <utility>
 #include "result.hpp"
@@ -22,6 +23,8 @@
 #include "stack.hpp"
 #include "register.hpp"
 #include "memory.hpp"
+#include "clock.hpp"
+#include "histogram.hpp"
 
 /**
  * A table of io ids to callbacks.
@@ -32,6 +35,9 @@ class IoTable {
   /// The table`s arr
   std::array<Callback*, IO_TABLE_SIZE> callbacks{};
 
+  /// The latencies of the calls per I/O id, empty if statistics are disabled
+  std::vector<LatencyHistogram> stats;
+
  public:
   /**
    * Constructs an empty interrupt table.
@@ -57,8 +63,8 @@ class IoTable {
    * Runs the callback for a given I/O id. Doesn't call anything if I/O id is invalid or if the callback is a `nullptr`
    * @param id The I/O id.
    */
-  void call(size_t id) const noexcept {
-    if (id >= INTERRUPT_TABLE_SIZE) {
+  void call(size_t id) noexcept {
+    if (id >= IO_TABLE_SIZE) {
       return;
     }
 
@@ -67,7 +73,40 @@ class IoTable {
       return;
     }
 
+    if (stats.empty()) {
+      callback->run();
+      return;
+    }
+
+    // Measure the callback`s latency.
+    const auto begin = cycle_now();
     callback->run();
+    stats[id].record(cycle_now() - begin);
+  }
+
+  /**
+   * Sets the callback of an I/O id. The table doesn`t take ownership of the callback.
+   * @param id The I/O id.
+   * @param callback The callback, `nullptr` to call nothing.
+   * @return `IllegalMemoryAddress` if the I/O id is invalid, Unit otherwise.
+   */
+  std::pair<ZError, Unit> set(size_t id, Callback *callback) noexcept {
+    if (id >= IO_TABLE_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    callbacks[id] = callback;
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Enables or disables per I/O id call statistics. Enabling clears previously gathered statistics.
+   * @param enabled Whether or not to gather statistics.
+   */
+  void enable_stats(bool enabled) {
+    stats.clear();
+    if (enabled) {
+      stats.resize(IO_TABLE_SIZE);
+    }
   }
 
   IoTableSnapshot snapshot() {
@@ -79,10 +118,116 @@ class IoTable {
         descriptions.emplace_back("nullptr");
       }
     }
-    return IoTableSnapshot{descriptions};
+    std::vector<IoStatsSnapshot> stat_snapshots;
+    for (const auto &histogram : stats) {
+      stat_snapshots.emplace_back(histogram.get_count(),
+                                  histogram.percentile(50.0),
+                                  histogram.percentile(99.0),
+                                  histogram.percentile(99.9),
+                                  histogram.get_max());
+    }
+    return IoTableSnapshot{descriptions, stat_snapshots};
   }
 };
 
 
+/**
+ * An I/O request a guest made while its vm queues I/O instead of calling callbacks.
+ */
+class IoRequest {
+ private:
+  /// The I/O id.
+  uint32_t io_id;
+
+  /// The core that made the request.
+  uint32_t core_id;
+
+  /// The I/O memory bytes the vm copied when the request was made.
+  std::vector<uint8_t> payload;
+
+ public:
+  /**
+   * Default constructor
+   */
+  IoRequest() : io_id{}, core_id{}, payload{} {
+  }
+
+  /**
+   * Constructs a request.
+   * @param io_id The I/O id.
+   * @param core_id The core that made the request.
+   * @param payload The I/O memory bytes copied when the request was made.
+   */
+  IoRequest(uint32_t io_id, uint32_t core_id, std::vector<uint8_t> payload) noexcept
+      : io_id{io_id}, core_id{core_id}, payload(std::move(payload)) {
+  }
+
+  /**
+   * Gets the I/O id.
+   */
+  uint32_t get_io_id() const noexcept {
+    return io_id;
+  }
+
+  /**
+   * Gets the core that made the request.
+   */
+  uint32_t get_core_id() const noexcept {
+    return core_id;
+  }
+
+  /**
+   * Gets the I/O memory bytes copied when the request was made.
+   */
+  const std::vector<uint8_t> &get_payload() const noexcept {
+    return payload;
+  }
+};
+
+/**
+ * A queue of I/O requests, filled by a running vm and drained by the host in batches, possibly from another thread.
+ * Hosts where calling back into them is expensive, e.g. Python, handle all requests of a run in one call.
+ */
+class IoRequestQueue {
+ private:
+  /// Guards `requests`.
+  std::mutex lock;
+
+  /// The queued requests.
+  std::vector<IoRequest> requests;
+
+ public:
+  IoRequestQueue() = default;
+  IoRequestQueue(const IoRequestQueue &) = delete;
+  IoRequestQueue &operator=(const IoRequestQueue &) = delete;
+
+  /**
+   * Queues a request.
+   * @param request The request.
+   */
+  void push(IoRequest request) {
+    std::lock_guard<std::mutex> guard(lock);
+    requests.push_back(std::move(request));
+  }
+
+  /**
+   * Takes all queued requests.
+   * @return The requests, oldest first.
+   */
+  std::vector<IoRequest> drain() {
+    std::vector<IoRequest> drained;
+    std::lock_guard<std::mutex> guard(lock);
+    drained.swap(requests);
+    return drained;
+  }
+
+  /**
+   * Gets the number of queued requests.
+   */
+  size_t size() {
+    std::lock_guard<std::mutex> guard(lock);
+    return requests.size();
+  }
+};
 
 #endif //ZAGROS_IO
@@ -11,7 +11,9 @@
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <utility>
+#include <vector>
 #include "result.hpp"
 #include "cell.hpp"
 #include "zagros_configuration.h"
@@ -19,6 +21,9 @@
 #include "snapshot.hpp"
 #include "stack.hpp"
 #include "register.hpp"
+#include "sort.hpp"
+#include "dsp.hpp"
+#include "fft.hpp"
 
 
 /**
@@ -29,11 +34,270 @@ class Memory {
  private:
   /// The memory`s data.
   std::array<uint8_t, MEMORY_SIZE> arr;
+
+  /// Whether each page was written to since the last `restore_dirty`.
+  std::array<bool, MEMORY_PAGE_COUNT> dirty;
+
+  /// The number of watched ranges overlapping each page.
+  std::array<uint16_t, MEMORY_PAGE_COUNT> watched;
+
+  /// The watched ranges as (address, length) pairs.
+  std::vector<std::pair<size_t, size_t>> watches;
+
+  /// Whether a watched range was written to since the last `take_watch_hit`.
+  bool watch_hit = false;
+
+  /// The address of the last write to a watched range.
+  size_t watch_addr = 0;
+
+  /// Whether each address has a breakpoint, one bit per address.
+  std::array<uint8_t, (MEMORY_SIZE + 7) / 8> breakpoint_bits;
+
+  /// The breakpoints as (address, original byte) pairs.
+  std::vector<std::pair<size_t, uint8_t>> breakpoints;
+
+  /// Whether the breakpoints are patched into memory, `false` if there are none.
+  bool patched = false;
+
+  /**
+   * Patches the breakpoints in a range of memory written to again, keeping the written bytes as the originals.
+   * @param addr The address of the range, must be legal.
+   * @param len The length of the range.
+   */
+  auto repatch(size_t addr, size_t len) noexcept -> void {
+    for (auto &breakpoint : breakpoints) {
+      if (breakpoint.first >= addr && breakpoint.first - addr < len) {
+        breakpoint.second = arr[breakpoint.first];
+        arr[breakpoint.first] = BREAKPOINT_OPCODE;
+      }
+    }
+  }
+
+  /**
+   * Replaces the patched breakpoints in bytes read from memory with the original bytes.
+   * @param out The bytes.
+   * @param addr The address the bytes were read from.
+   * @param len The number of bytes.
+   */
+  auto hide_breakpoints(uint8_t *out, size_t addr, size_t len) const noexcept -> void {
+    for (const auto &breakpoint : breakpoints) {
+      if (breakpoint.first >= addr && breakpoint.first - addr < len) {
+        out[breakpoint.first - addr] = breakpoint.second;
+      }
+    }
+  }
+
+  /**
+   * Writes the original bytes back over the patched breakpoints, until `patch_breakpoints`.
+   */
+  auto lift_breakpoints() noexcept -> void {
+    if (!patched) {
+      return;
+    }
+    for (const auto &breakpoint : breakpoints) {
+      arr[breakpoint.first] = breakpoint.second;
+    }
+    patched = false;
+  }
+
+  /**
+   * Marks the pages of a range of memory as dirty.
+   * @param addr The address of the range, must be legal.
+   * @param len The length of the range.
+   */
+  auto mark_dirty(size_t addr, size_t len) noexcept -> void {
+    if (len == 0) {
+      return;
+    }
+    if (patched) {
+      repatch(addr, len);
+    }
+    const auto last = (addr + len - 1) / MEMORY_PAGE_SIZE;
+    for (auto page = addr / MEMORY_PAGE_SIZE; page <= last; ++page) {
+      dirty[page] = true;
+    }
+  }
+
+  /**
+   * Marks the pages of a range of memory written by the guest as dirty, and checks it against the watched ranges.
+   * Only pages with a watched range are checked, so writes cost nothing extra while nothing is watched nearby.
+   * @param addr The address of the range, must be legal.
+   * @param len The length of the range.
+   */
+  auto mark_written(size_t addr, size_t len) noexcept -> void {
+    if (len == 0) {
+      return;
+    }
+    if (patched) {
+      repatch(addr, len);
+    }
+    const auto last = (addr + len - 1) / MEMORY_PAGE_SIZE;
+    for (auto page = addr / MEMORY_PAGE_SIZE; page <= last; ++page) {
+      dirty[page] = true;
+      if (watched[page] != 0) {
+        check_watches(addr, len);
+      }
+    }
+  }
+
+  /**
+   * Checks a written range against the watched ranges.
+   * @param addr The address of the range.
+   * @param len The length of the range.
+   */
+  auto check_watches(size_t addr, size_t len) noexcept -> void {
+    for (const auto &watch : watches) {
+      if (addr < watch.first + watch.second && watch.first < addr + len) {
+        watch_hit = true;
+        watch_addr = std::max(addr, watch.first);
+        return;
+      }
+    }
+  }
+
+  /**
+   * Adds to the watch count of the pages of a range.
+   * @param addr The address of the range, must be legal.
+   * @param len The length of the range, not 0.
+   * @param delta 1 to add a range, -1 to remove it.
+   */
+  auto count_watch(size_t addr, size_t len, int delta) noexcept -> void {
+    const auto last = (addr + len - 1) / MEMORY_PAGE_SIZE;
+    for (auto page = addr / MEMORY_PAGE_SIZE; page <= last; ++page) {
+      watched[page] = static_cast<uint16_t>(watched[page] + delta);
+    }
+  }
+
+  /**
+   * Reads a little endian word.
+   * @param addr The address of the word, must be legal.
+   * @return The word.
+   */
+  auto read_word(size_t addr) const noexcept -> uint32_t {
+    std::array<uint8_t, 4> bytes = {arr[addr], arr[addr + 1], arr[addr + 2], arr[addr + 3]};
+    if (patched) {
+      hide_breakpoints(bytes.data(), addr, bytes.size());
+    }
+    return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+        static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+  }
+
+  /**
+   * Writes a little endian word without marking it dirty.
+   * @param addr The address of the word, must be legal.
+   * @param word The word.
+   */
+  auto write_word(size_t addr, uint32_t word) noexcept -> void {
+    arr[addr] = static_cast<uint8_t>(word);
+    arr[addr + 1] = static_cast<uint8_t>(word >> 8);
+    arr[addr + 2] = static_cast<uint8_t>(word >> 16);
+    arr[addr + 3] = static_cast<uint8_t>(word >> 24);
+  }
+
+  /**
+   * Checks whether an array of words is in memory.
+   * @param addr The address of the array.
+   * @param len The number of words.
+   * @return Whether the array is in memory.
+   */
+  static auto legal_words(size_t addr, size_t len) noexcept -> bool {
+    return len <= MEMORY_SIZE / 4 && addr + len * 4 <= MEMORY_SIZE;
+  }
+
+  /**
+   * Reads an array of little endian words as values of a type of the same size.
+   * @tparam T The type.
+   * @param addr The address of the array, must be legal.
+   * @param len The number of words.
+   * @return The values.
+   */
+  template<typename T>
+  auto read_values(size_t addr, size_t len) const -> std::vector<T> {
+    static_assert(sizeof(T) == 4, "Values must be the size of a word.");
+    std::vector<T> values(len);
+    for (size_t i = 0; i < len; ++i) {
+      const auto word = read_word(addr + i * 4);
+      std::memcpy(&values[i], &word, 4);
+    }
+    return values;
+  }
+
+  /**
+   * Writes values of a type the size of a word as an array of little endian words.
+   * @tparam T The type.
+   * @param addr The address of the array, must be legal.
+   * @param values The values.
+   */
+  template<typename T>
+  auto write_values(size_t addr, const std::vector<T> &values) noexcept -> void {
+    for (size_t i = 0; i < values.size(); ++i) {
+      uint32_t word;
+      std::memcpy(&word, &values[i], 4);
+      write_word(addr + i * 4, word);
+    }
+    mark_written(addr, values.size() * 4);
+  }
+
+  /**
+   * Computes the dot product of two arrays of values.
+   * @tparam T The type of the values.
+   * @param a The address of the first array, must be legal.
+   * @param b The address of the second array, must be legal.
+   * @param len The number of values.
+   * @return The dot product as a word.
+   */
+  template<typename T>
+  auto dot_values(size_t a, size_t b, size_t len) const -> uint32_t {
+    const auto a_values = read_values<T>(a, len);
+    const auto b_values = read_values<T>(b, len);
+    const auto dot = dsp_dot(a_values.data(), b_values.data(), len);
+    uint32_t word;
+    std::memcpy(&word, &dot, 4);
+    return word;
+  }
+
+  /**
+   * Runs a FIR filter over an array of values.
+   * @tparam T The type of the values.
+   * @param out The address of the filtered values, must be legal.
+   * @param in The address of the window of values, must be legal.
+   * @param taps The address of the taps, must be legal.
+   * @param tap_count The number of taps, at least 1.
+   * @param len The number of filtered values.
+   */
+  template<typename T>
+  auto filter_values(size_t out, size_t in, size_t taps, size_t tap_count, size_t len) -> void {
+    const auto in_values = read_values<T>(in, len + tap_count - 1);
+    const auto tap_values = read_values<T>(taps, tap_count);
+    std::vector<T> out_values(len);
+    dsp_fir(out_values.data(), in_values.data(), tap_values.data(), tap_count, len);
+    write_values(out, out_values);
+  }
+
+  /**
+   * Multiplies two row major matrices of values.
+   * @tparam T The type of the values.
+   * @param c The address of the product, must be legal.
+   * @param a The address of the left matrix, must be legal.
+   * @param b The address of the right matrix, must be legal.
+   * @param rows The number of rows of the left matrix.
+   * @param inner The number of columns of the left matrix and rows of the right one.
+   * @param cols The number of columns of the right matrix.
+   */
+  template<typename T>
+  auto multiply_values(size_t c, size_t a, size_t b, size_t rows, size_t inner, size_t cols) -> void {
+    const auto a_values = read_values<T>(a, rows * inner);
+    const auto b_values = read_values<T>(b, inner * cols);
+    std::vector<T> c_values(rows * cols);
+    dsp_matrix_multiply(c_values.data(), a_values.data(), b_values.data(), rows, inner, cols);
+    write_values(c, c_values);
+  }
+
  public:
   /**
    * Constructs a new memory bank. All memory is initialized to 0.
    */
-  Memory() noexcept: arr{} {
+  Memory() noexcept: arr{}, dirty{}, watched{}, breakpoint_bits{} {
   }
 
   /**
@@ -71,6 +335,9 @@ class Memory {
     for (; i < 4; ++i) {
       dst[i] = 0;
     }
+    if (patched) {
+      hide_breakpoints(dst.data(), addr, BS);
+    }
     return {ZError::None, Cell{dst}};
   }
 
@@ -88,7 +355,16 @@ class Memory {
     if (orig + len > MEMORY_SIZE) {
       return {ZError::IllegalMemoryAddress, Cell{}};
     }
-    if (std::equal(arr.begin() + dst, arr.begin() + dst + len, arr.begin() + orig)) {
+    if (patched) {
+      // Compare the original instructions, not the traps.
+      size_t i = 0;
+      while (i < len && std::get<1>(read_bytes<1>(dst + i)) == std::get<1>(read_bytes<1>(orig + i))) {
+        i += 1;
+      }
+      if (i == len) {
+        return {ZError::None, Cell{true}};
+      }
+    } else if (std::equal(arr.begin() + dst, arr.begin() + dst + len, arr.begin() + orig)) {
       return {ZError::None, Cell{true}};
     }
     return {ZError::None, Cell{true}};
@@ -112,11 +388,14 @@ class Memory {
     for (int i = 0; i < BS; ++i) {
       arr[addr + i] = src[i];
     }
+    mark_written(addr, BS);
     return {ZError::None, Unit{}};
   }
 
   /**
-   * Copies a block of memory to another.
+   * Copies a block of memory to another. The blocks may overlap, the destination ends up holding the origin`s
+   * bytes as they were before the copy.
+   * Small copies are done inline, larger ones by `memmove`, which picks `rep movsb` or vector copies by size.
    * @param len The number of bytes to copy.
    * @param dst The destination addrs.
    * @param orig The origin addrs.
@@ -126,10 +405,189 @@ class Memory {
     if (dst + len > MEMORY_SIZE || orig + len > MEMORY_SIZE) {
       return {ZError::IllegalMemoryAddress, Unit{}};
     }
-    std::copy_n(arr.begin() + orig, len, arr.begin() + dst);
+    if (len <= INLINE_COPY_SIZE) {
+      // Copy away from the overlap so no byte is overwritten before it is read.
+      if (dst <= orig) {
+        for (size_t i = 0; i < len; ++i) {
+          arr[dst + i] = arr[orig + i];
+        }
+      } else {
+        for (size_t i = len; i > 0; --i) {
+          arr[dst + i - 1] = arr[orig + i - 1];
+        }
+      }
+    } else {
+      std::memmove(arr.data() + dst, arr.data() + orig, len);
+    }
+    // Copy the original instructions, not the traps.
+    if (patched) {
+      hide_breakpoints(arr.data() + dst, orig, len);
+    }
+    mark_written(dst, len);
     return {ZError::None, Unit{}};
   }
 
+  /**
+   * Sorts an array of little endian words in place, in the order of an operation mode.
+   * @param addr The address of the array.
+   * @param len The number of words.
+   * @param mode The operation mode.
+   * @return `IllegalMemoryAddress` if the array isn`t in memory, Unit otherwise.
+   */
+  auto sort_words(size_t addr, size_t len, OpMode mode) -> std::pair<ZError, Unit> {
+    if (len > MEMORY_SIZE / 4 || addr + len * 4 > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    std::vector<uint32_t> keys(len);
+    for (size_t i = 0; i < len; ++i) {
+      keys[i] = sort_key(read_word(addr + i * 4), mode);
+    }
+    sort_keys(keys);
+    for (size_t i = 0; i < len; ++i) {
+      write_word(addr + i * 4, sort_word(keys[i], mode));
+    }
+    mark_written(addr, len * 4);
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Binary searches an array of little endian words sorted in the order of an operation mode.
+   * @param addr The address of the array.
+   * @param len The number of words.
+   * @param word The word to search for.
+   * @param mode The operation mode.
+   * @return The index of the first word not ordered before `word`, i.e. where to insert it,
+   * or `IllegalMemoryAddress` if the array isn`t in memory.
+   */
+  auto search_words(size_t addr, size_t len, uint32_t word, OpMode mode) const noexcept
+  -> std::pair<ZError, uint32_t> {
+    if (len > MEMORY_SIZE / 4 || addr + len * 4 > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, uint32_t{}};
+    }
+    const auto key = sort_key(word, mode);
+    size_t first = 0;
+    size_t count = len;
+    while (count > 0) {
+      const auto half = count / 2;
+      if (sort_key(read_word(addr + (first + half) * 4), mode) < key) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return {ZError::None, static_cast<uint32_t>(first)};
+  }
+
+  /**
+   * Computes the dot product of two arrays of words in an operation mode.
+   * Signed and unsigned words share wrapping integer arithmetic.
+   * @param a The address of the first array.
+   * @param b The address of the second array.
+   * @param len The number of words.
+   * @param mode The operation mode.
+   * @return The dot product, or `IllegalMemoryAddress` if an array isn`t in memory.
+   */
+  auto dot_words(size_t a, size_t b, size_t len, OpMode mode) const -> std::pair<ZError, uint32_t> {
+    if (!legal_words(a, len) || !legal_words(b, len)) {
+      return {ZError::IllegalMemoryAddress, uint32_t{}};
+    }
+    if (mode == OpMode::FLOAT) {
+      return {ZError::None, dot_values<float>(a, b, len)};
+    }
+    return {ZError::None, dot_values<uint32_t>(a, b, len)};
+  }
+
+  /**
+   * Runs a FIR filter over an array of words in an operation mode, see `dsp_fir`.
+   * The output may overlap the inputs, they are read before it is written.
+   * @param out The address of the filtered words, `len` words.
+   * @param in The address of the window of words, `len + tap_count - 1` words.
+   * @param taps The address of the taps.
+   * @param tap_count The number of taps.
+   * @param len The number of filtered words.
+   * @param mode The operation mode.
+   * @return Unit if successful, `IllegalOperand` if there are no taps,
+   * `IllegalMemoryAddress` if an array isn`t in memory.
+   */
+  auto filter_words(size_t out, size_t in, size_t taps, size_t tap_count, size_t len, OpMode mode)
+  -> std::pair<ZError, Unit> {
+    if (tap_count == 0) {
+      return {ZError::IllegalOperand, Unit{}};
+    }
+    if (!legal_words(out, len) || !legal_words(taps, tap_count) || !legal_words(in, len + tap_count - 1)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    if (mode == OpMode::FLOAT) {
+      filter_values<float>(out, in, taps, tap_count, len);
+    } else {
+      filter_values<uint32_t>(out, in, taps, tap_count, len);
+    }
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Multiplies two row major matrices of words in an operation mode, `c = a * b`.
+   * A matrix-vector product is a product with one column. The product may overlap the matrices,
+   * they are read before it is written.
+   * @param c The address of the product.
+   * @param a The address of the left matrix.
+   * @param b The address of the right matrix.
+   * @param rows The number of rows of the left matrix.
+   * @param inner The number of columns of the left matrix and rows of the right one.
+   * @param cols The number of columns of the right matrix.
+   * @param mode The operation mode.
+   * @return Unit if successful, `IllegalMemoryAddress` if a matrix isn`t in memory.
+   */
+  auto multiply_matrices(size_t c, size_t a, size_t b, size_t rows, size_t inner, size_t cols, OpMode mode)
+  -> std::pair<ZError, Unit> {
+    if (rows > MEMORY_SIZE || inner > MEMORY_SIZE || cols > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    if (!legal_words(c, rows * cols) || !legal_words(a, rows * inner) || !legal_words(b, inner * cols)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    if (mode == OpMode::FLOAT) {
+      multiply_values<float>(c, a, b, rows, inner, cols);
+    } else {
+      multiply_values<uint32_t>(c, a, b, rows, inner, cols);
+    }
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Transforms an array of complex floats in place by an FFT, or its inverse scaled by `1 / points`.
+   * @param addr The address of the array, interleaved (real, imaginary) float words.
+   * @param points The number of complex floats, a power of two.
+   * @param inverse Whether to do the inverse transform.
+   * @param twiddles The cache of twiddle factors.
+   * @return Unit if successful, `IllegalOperand` if `points` isn`t a power of two,
+   * `IllegalMemoryAddress` if the array isn`t in memory.
+   */
+  auto fourier_transform(size_t addr, size_t points, bool inverse, TwiddleCache &twiddles)
+  -> std::pair<ZError, Unit> {
+    if (points == 0 || (points & (points - 1)) != 0) {
+      return {ZError::IllegalOperand, Unit{}};
+    }
+    if (points > MEMORY_SIZE || !legal_words(addr, points * 2)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    auto values = read_values<float>(addr, points * 2);
+    fft(values.data(), points, twiddles.get(points), inverse);
+    write_values(addr, values);
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Loads a program at address 0 without copying a whole memory array.
+   * @param prg The program.
+   * @param prg_size The size of the program.
+   * @return `IllegalMemoryAddress` if the program doesn`t fit into memory, Unit otherwise.
+   */
+  auto load_program(const uint8_t *prg, size_t prg_size) noexcept -> std::pair<ZError, Unit> {
+    return write_block(0, prg, prg_size);
+  }
+
   /**
    * Loads the memory from a memory array.
    * @param prg The memory array.
@@ -140,6 +598,7 @@ class Memory {
     }
     // Copy the program into the memory.
     std::copy_n(prg.begin(), prg_size, arr.begin());
+    mark_dirty(0, prg_size);
     return {ZError::None, Unit{}};
   }
 
@@ -154,6 +613,7 @@ class Memory {
       return {ZError::IllegalMemoryAddress, Unit{}};
     }
     arr[addr] = byte;
+    mark_dirty(addr, 1);
     return {ZError::None, Unit{}};
   }
 
@@ -166,7 +626,215 @@ class Memory {
     if (addr < IO_MEMORY_ADDRESS_BEGIN || addr >= IO_MEMORY_ADDRESS_END) {
       return {ZError::IllegalMemoryAddress, uint8_t {}};
     }
-    return {ZError::None, arr[addr]};
+    auto byte = arr[addr];
+    if (patched) {
+      hide_breakpoints(&byte, addr, 1);
+    }
+    return {ZError::None, byte};
+  }
+
+  /**
+   * Writes a block of bytes into memory.
+   * @param addr The address of the block.
+   * @param bytes The bytes.
+   * @param len The number of bytes.
+   * @return A success outcome if the block is legal,
+   * otherwise and error outcome with `ZError::IllegalMemoryAddress`.
+   */
+  auto write_block(size_t addr, const uint8_t *bytes, size_t len) noexcept -> std::pair<ZError, Unit> {
+    if (addr + len > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    std::copy_n(bytes, len, arr.begin() + addr);
+    mark_dirty(addr, len);
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Reads a block of bytes from memory.
+   * @param addr The address of the block.
+   * @param len The number of bytes.
+   * @return The bytes if the block is legal, `ZError::IllegalMemoryAddress` otherwise.
+   */
+  auto read_block(size_t addr, size_t len) const -> std::pair<ZError, std::vector<uint8_t>> {
+    if (addr + len > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, std::vector<uint8_t>{}};
+    }
+    std::vector<uint8_t> bytes(arr.begin() + addr, arr.begin() + addr + len);
+    if (patched) {
+      hide_breakpoints(bytes.data(), addr, len);
+    }
+    return {ZError::None, bytes};
+  }
+
+  /**
+   * Copies a block of bytes out of memory.
+   * @param addr The address of the block.
+   * @param out The buffer to copy into.
+   * @param len The number of bytes.
+   * @return A success outcome if the block is legal,
+   * otherwise and error outcome with `ZError::IllegalMemoryAddress`.
+   */
+  auto read_block(size_t addr, uint8_t *out, size_t len) const noexcept -> std::pair<ZError, Unit> {
+    if (addr + len > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    std::copy_n(arr.begin() + addr, len, out);
+    if (patched) {
+      hide_breakpoints(out, addr, len);
+    }
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Copies the pages written to since the last call back from another memory and marks all pages clean.
+   * Pages that weren`t written to must already equal `base`, e.g. because this memory was copied from it.
+   * The breakpoints of this memory are patched into the restored instructions again, those of `base` aren`t copied.
+   * @param base The memory to restore from.
+   */
+  auto restore_dirty(const Memory &base) noexcept -> void {
+    lift_breakpoints();
+    for (size_t page = 0; page < MEMORY_PAGE_COUNT; ++page) {
+      if (!dirty[page]) {
+        continue;
+      }
+      const auto begin = page * MEMORY_PAGE_SIZE;
+      const auto len = std::min(MEMORY_PAGE_SIZE, MEMORY_SIZE - begin);
+      std::copy_n(base.arr.begin() + begin, len, arr.begin() + begin);
+      if (base.patched) {
+        base.hide_breakpoints(arr.data() + begin, begin, len);
+      }
+      dirty[page] = false;
+    }
+    patch_breakpoints();
+  }
+
+  /**
+   * Gets the memory`s data for direct access by the host.
+   * All pages are marked dirty, writes through the pointer after the next `restore_dirty` aren`t tracked.
+   * The breakpoints are lifted, so the host sees and writes the original instructions until `patch_breakpoints`,
+   * which the vm calls before running.
+   * @return The first byte of the memory.
+   */
+  auto data() noexcept -> uint8_t * {
+    lift_breakpoints();
+    dirty.fill(true);
+    return arr.data();
+  }
+
+  /**
+   * Watches a range of memory, so guest writes to it are reported by `take_watch_hit`.
+   * @param addr The address of the range.
+   * @param len The length of the range.
+   * @return A success outcome if the range is legal and not empty,
+   * otherwise and error outcome with `ZError::IllegalMemoryAddress`.
+   */
+  auto watch(size_t addr, size_t len) -> std::pair<ZError, Unit> {
+    if (len == 0 || addr + len > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    watches.emplace_back(addr, len);
+    count_watch(addr, len, 1);
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Stops watching a range of memory.
+   * @param addr The address of the range, as given to `watch`.
+   * @param len The length of the range, as given to `watch`.
+   * @return A success outcome if the range was watched,
+   * otherwise and error outcome with `ZError::IllegalMemoryAddress`.
+   */
+  auto unwatch(size_t addr, size_t len) noexcept -> std::pair<ZError, Unit> {
+    const auto it = std::find(watches.begin(), watches.end(), std::make_pair(addr, len));
+    if (it == watches.end()) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    watches.erase(it);
+    count_watch(addr, len, -1);
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Takes whether a watched range was written to since the last call.
+   * @return Whether a watched range was written to.
+   */
+  auto take_watch_hit() noexcept -> bool {
+    const auto hit = watch_hit;
+    watch_hit = false;
+    return hit;
+  }
+
+  /**
+   * Gets the address of the last write to a watched range.
+   * @return The address.
+   */
+  auto get_watch_addr() const noexcept -> size_t {
+    return watch_addr;
+  }
+
+  /**
+   * Patches the breakpoints into memory after `data` lifted them, keeping the bytes there as the originals.
+   * Does nothing if they are patched already.
+   */
+  auto patch_breakpoints() noexcept -> void {
+    if (patched || breakpoints.empty()) {
+      return;
+    }
+    for (auto &breakpoint : breakpoints) {
+      breakpoint.second = arr[breakpoint.first];
+      arr[breakpoint.first] = BREAKPOINT_OPCODE;
+    }
+    patched = true;
+  }
+
+  /**
+   * Sets a breakpoint, patching `BREAKPOINT_OPCODE` over the byte at an address until it is cleared.
+   * The original byte is kept aside, so reads, copies and snapshots see it instead of the trap, writes replace it
+   * and restores keep the breakpoint.
+   * @param addr The address.
+   * @return A success outcome if `addr` is legal, otherwise an error outcome with `ZError::IllegalMemoryAddress`.
+   */
+  auto set_breakpoint(size_t addr) -> std::pair<ZError, Unit> {
+    if (addr >= MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    if (!has_breakpoint(addr)) {
+      lift_breakpoints();
+      breakpoint_bits[addr / 8] |= static_cast<uint8_t>(1u << (addr % 8));
+      breakpoints.emplace_back(addr, uint8_t{});
+      patch_breakpoints();
+    }
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Clears a breakpoint.
+   * @param addr The address.
+   * @return A success outcome if `addr` has a breakpoint,
+   * otherwise an error outcome with `ZError::IllegalMemoryAddress`.
+   */
+  auto clear_breakpoint(size_t addr) noexcept -> std::pair<ZError, Unit> {
+    if (addr >= MEMORY_SIZE || !has_breakpoint(addr)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    lift_breakpoints();
+    breakpoint_bits[addr / 8] &= static_cast<uint8_t>(~(1u << (addr % 8)));
+    breakpoints.erase(std::find_if(breakpoints.begin(), breakpoints.end(),
+                                   [addr](const std::pair<size_t, uint8_t> &breakpoint) {
+                                     return breakpoint.first == addr;
+                                   }));
+    patch_breakpoints();
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Checks whether an address has a breakpoint.
+   * @param addr The address, must be legal.
+   * @return Whether the address has a breakpoint.
+   */
+  auto has_breakpoint(size_t addr) const noexcept -> bool {
+    return (breakpoint_bits[addr / 8] >> (addr % 8) & 1) != 0;
   }
 
   /**
@@ -174,6 +842,10 @@ class Memory {
    */
   auto clear() -> void {
     std::fill(arr.begin(), arr.end(), 0);
+    dirty.fill(true);
+    if (patched) {
+      repatch(0, MEMORY_SIZE);
+    }
   }
 
   /**
@@ -181,9 +853,72 @@ class Memory {
    * @return A snapshot of the memory.
    */
   auto snapshot() const noexcept -> MemorySnapshot {
+    if (patched) {
+      auto copy = arr;
+      hide_breakpoints(copy.data(), 0, MEMORY_SIZE);
+      return MemorySnapshot(copy);
+    }
     return MemorySnapshot(arr);
   }
 };
 
+/**
+ * Owns a memory allocated on the heap, so vms move without copying tens of kilobytes.
+ * Copies are deep. A moved from box may only be assigned to or destroyed.
+ */
+class MemoryBox {
+ private:
+  /// The memory.
+  std::unique_ptr<Memory> ptr;
+
+ public:
+  /**
+   * Allocates a zeroed memory.
+   */
+  MemoryBox() : ptr(new Memory()) {}
+
+  /**
+   * Allocates a copy of another box` memory.
+   * @param other The box.
+   */
+  MemoryBox(const MemoryBox &other) : ptr(new Memory(*other.ptr)) {}
+
+  MemoryBox(MemoryBox &&other) noexcept = default;
+
+  /**
+   * Copies another box` memory into this one, reusing the allocation.
+   * @param other The box.
+   * @return This box.
+   */
+  auto operator=(const MemoryBox &other) -> MemoryBox & {
+    if (this != &other) {
+      if (ptr == nullptr) {
+        ptr.reset(new Memory(*other.ptr));
+      } else {
+        *ptr = *other.ptr;
+      }
+    }
+    return *this;
+  }
+
+  auto operator=(MemoryBox &&other) noexcept -> MemoryBox & = default;
+
+  auto operator->() noexcept -> Memory * {
+    return ptr.get();
+  }
+
+  auto operator->() const noexcept -> const Memory * {
+    return ptr.get();
+  }
+
+  auto operator*() noexcept -> Memory & {
+    return *ptr;
+  }
+
+  auto operator*() const noexcept -> const Memory & {
+    return *ptr;
+  }
+};
+
 
 #endif //ZAGROS_MEMORY
@@ -0,0 +1,185 @@
+#ifndef ZAGROS_METRICS
+#define ZAGROS_METRICS
+
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include "result.hpp"
+
+/// Number of `ZError` kinds, `SystemHalt` is always the last one.
+static const size_t ZERROR_COUNT = static_cast<size_t>(ZError::SystemHalt) + 1;
+
+/**
+ * Counters a guest can read with the `PF` instruction.
+ */
+enum class PerfCounterId {
+  /// The number of instructions retired by the current core.
+  RETIRED,
+
+  /// The host cycle counter, see `cycle_now`.
+  CYCLES,
+
+  /// The host monotonic clock in nanoseconds.
+  NANOSECONDS
+};
+
+/**
+ * Counters describing what a vm has been doing. Cycles are host cycles as read by `cycle_now`.
+ * Metrics of several vms, e.g. a pool running on several threads, can be added up with `merge`.
+ */
+class Metrics {
+ private:
+  /// The number of instructions retired by all cores.
+  uint64_t instructions_retired;
+
+  /// The number of host cycles spent running.
+  uint64_t cycles;
+
+  /// The number of times the scheduler switched to another core.
+  uint64_t core_switches;
+
+  /// The number of host cycles cores spent paused.
+  uint64_t parked_cycles;
+
+  /// The number of interrupts triggered while interrupts were enabled.
+  uint64_t interrupts_delivered;
+
+  /// The number of interrupts triggered while interrupts were disabled.
+  uint64_t interrupts_masked;
+
+  /// The number of I/O calls.
+  uint64_t io_calls;
+
+  /// The number of I/O calls and accesses with an illegal I/O id or address.
+  uint64_t io_errors;
+
+  /// The number of runs stopped by each `ZError` kind.
+  std::array<uint64_t, ZERROR_COUNT> stops;
+
+ public:
+  /**
+   * Default constructor
+   */
+  Metrics() : instructions_retired{}, cycles{}, core_switches{}, parked_cycles{}, interrupts_delivered{},
+              interrupts_masked{}, io_calls{}, io_errors{}, stops{} {
+  }
+
+  /**
+   * Constructs the metrics.
+   * @param instructions_retired The number of instructions retired by all cores.
+   * @param cycles The number of host cycles spent running.
+   * @param core_switches The number of times the scheduler switched to another core.
+   * @param parked_cycles The number of host cycles cores spent paused.
+   * @param interrupts_delivered The number of interrupts triggered while interrupts were enabled.
+   * @param interrupts_masked The number of interrupts triggered while interrupts were disabled.
+   * @param io_calls The number of I/O calls.
+   * @param io_errors The number of I/O calls and accesses with an illegal I/O id or address.
+   * @param stops The number of runs stopped by each `ZError` kind.
+   */
+  Metrics(uint64_t instructions_retired, uint64_t cycles, uint64_t core_switches, uint64_t parked_cycles,
+          uint64_t interrupts_delivered, uint64_t interrupts_masked, uint64_t io_calls, uint64_t io_errors,
+          std::array<uint64_t, ZERROR_COUNT> stops) noexcept
+      : instructions_retired{instructions_retired}, cycles{cycles}, core_switches{core_switches},
+        parked_cycles{parked_cycles}, interrupts_delivered{interrupts_delivered},
+        interrupts_masked{interrupts_masked}, io_calls{io_calls}, io_errors{io_errors}, stops(stops) {
+  }
+
+  /**
+   * Gets the number of instructions retired by all cores.
+   */
+  uint64_t get_instructions_retired() const noexcept {
+    return instructions_retired;
+  }
+
+  /**
+   * Gets the number of host cycles spent running.
+   */
+  uint64_t get_cycles() const noexcept {
+    return cycles;
+  }
+
+  /**
+   * Gets the number of times the scheduler switched to another core.
+   */
+  uint64_t get_core_switches() const noexcept {
+    return core_switches;
+  }
+
+  /**
+   * Gets the number of host cycles cores spent paused.
+   */
+  uint64_t get_parked_cycles() const noexcept {
+    return parked_cycles;
+  }
+
+  /**
+   * Gets the number of interrupts triggered while interrupts were enabled.
+   */
+  uint64_t get_interrupts_delivered() const noexcept {
+    return interrupts_delivered;
+  }
+
+  /**
+   * Gets the number of interrupts triggered while interrupts were disabled.
+   */
+  uint64_t get_interrupts_masked() const noexcept {
+    return interrupts_masked;
+  }
+
+  /**
+   * Gets the number of I/O calls.
+   */
+  uint64_t get_io_calls() const noexcept {
+    return io_calls;
+  }
+
+  /**
+   * Gets the number of I/O calls and accesses with an illegal I/O id or address.
+   */
+  uint64_t get_io_errors() const noexcept {
+    return io_errors;
+  }
+
+  /**
+   * Gets the number of runs stopped by an error kind.
+   * @param err The error kind.
+   */
+  uint64_t get_stops(ZError err) const noexcept {
+    return stops[static_cast<size_t>(err)];
+  }
+
+  /**
+   * Adds the counters of another vm.
+   * @param rhs The other vm`s metrics.
+   */
+  void merge(const Metrics &rhs) noexcept {
+    instructions_retired += rhs.instructions_retired;
+    cycles += rhs.cycles;
+    core_switches += rhs.core_switches;
+    parked_cycles += rhs.parked_cycles;
+    interrupts_delivered += rhs.interrupts_delivered;
+    interrupts_masked += rhs.interrupts_masked;
+    io_calls += rhs.io_calls;
+    io_errors += rhs.io_errors;
+    for (size_t i = 0; i < ZERROR_COUNT; ++i) {
+      stops[i] += rhs.stops[i];
+    }
+  }
+
+  virtual std::string toString() const {
+    std::stringstream os;
+    os << "{ instructions_retired: " << instructions_retired << " cycles: " << cycles
+       << " core_switches: " << core_switches << " parked_cycles: " << parked_cycles
+       << " interrupts_delivered: " << interrupts_delivered << " interrupts_masked: " << interrupts_masked
+       << " io_calls: " << io_calls << " io_errors: " << io_errors << " stops: [";
+    size_t i;
+    for (i = 0; i < stops.size() - 1; ++i) {
+      os << stops[i] << ", ";
+    }
+    os << stops[i] << "] }";
+    return os.str();
+  }
+};
+
+#endif //ZAGROS_METRICS
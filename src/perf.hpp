@@ -0,0 +1,372 @@
+#ifndef ZAGROS_PERF
+#define ZAGROS_PERF
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <elf.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Names a region of generated code after the guest routine it was compiled from.
+ * @param guest_addr The address of the guest routine.
+ * @param label The label of the guest routine, may be empty.
+ * @return The symbol name shown by `perf report`.
+ */
+inline auto perf_region_name(uint32_t guest_addr, const std::string &label) -> std::string {
+  std::stringstream os;
+  os << "zagros:";
+  if (!label.empty()) {
+    os << label << "@";
+  }
+  os << "0x" << std::hex << guest_addr;
+  return os.str();
+}
+
+/**
+ * Writes `/tmp/perf-<pid>.map` entries so `perf report` can symbolize generated code.
+ * Does nothing on hosts other than Linux.
+ */
+class PerfMap {
+ private:
+  /// The map file, `nullptr` if it couldn`t be opened.
+  FILE *file = nullptr;
+
+ public:
+  PerfMap() noexcept = default;
+  PerfMap(const PerfMap &) = delete;
+  PerfMap &operator=(const PerfMap &) = delete;
+
+  ~PerfMap() {
+    close();
+  }
+
+  /**
+   * Opens the map file of the current process for appending.
+   * @param path The file, `nullptr` for the `/tmp/perf-<pid>.map` file perf looks for.
+   * @return Whether the file was opened.
+   */
+  auto open(const char *path = nullptr) noexcept -> bool {
+#ifdef __linux__
+    if (file != nullptr) {
+      return true;
+    }
+    char default_path[64];
+    if (path == nullptr) {
+      snprintf(default_path, sizeof(default_path), "/tmp/perf-%d.map", static_cast<int>(getpid()));
+      path = default_path;
+    }
+    file = fopen(path, "a");
+#endif
+    return file != nullptr;
+  }
+
+  /**
+   * Adds an entry for a region of generated code.
+   * @param code The start of the region.
+   * @param size The size of the region in bytes.
+   * @param name The symbol name, see `perf_region_name`.
+   */
+  auto add(const void *code, size_t size, const std::string &name) noexcept -> void {
+    if (file == nullptr) {
+      return;
+    }
+    fprintf(file, "%lx %zx %s\n", reinterpret_cast<unsigned long>(code), size, name.c_str());
+    fflush(file);
+  }
+
+  /**
+   * Closes the map file. The entries stay on disk for `perf report`.
+   */
+  auto close() noexcept -> void {
+    if (file != nullptr) {
+      fclose(file);
+      file = nullptr;
+    }
+  }
+};
+
+/**
+ * Writes a `/tmp/jit-<pid>.dump` file in the jitdump format, so `perf inject --jit` can attribute samples
+ * in generated code and annotate it. Record with `perf record -k mono`. Does nothing on hosts other than Linux.
+ */
+class JitDump {
+ private:
+  /// The dump file, `nullptr` if it couldn`t be opened.
+  FILE *file = nullptr;
+
+  /// The marker mapping perf uses to find the dump file.
+  void *marker = nullptr;
+
+  /// The index of the next code load record.
+  uint64_t code_index = 0;
+
+  /**
+   * Gets the timestamp of a record, must use the clock passed to `perf record -k`.
+   * @return The monotonic time in nanoseconds.
+   */
+  static auto timestamp() noexcept -> uint64_t {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+  }
+
+  /**
+   * Writes a value to the dump in host byte order.
+   * @param value The value.
+   */
+  template<class T>
+  auto write(T value) noexcept -> void {
+    fwrite(&value, sizeof(value), 1, file);
+  }
+
+ public:
+  JitDump() noexcept = default;
+  JitDump(const JitDump &) = delete;
+  JitDump &operator=(const JitDump &) = delete;
+
+  ~JitDump() {
+    close();
+  }
+
+  /**
+   * Creates the dump file of the current process and writes its header.
+   * @param path The file, `nullptr` for the `/tmp/jit-<pid>.dump` file perf looks for.
+   * @return Whether the file was created.
+   */
+  auto open(const char *path = nullptr) noexcept -> bool {
+#ifdef __linux__
+    if (file != nullptr) {
+      return true;
+    }
+    char default_path[64];
+    if (path == nullptr) {
+      snprintf(default_path, sizeof(default_path), "/tmp/jit-%d.dump", static_cast<int>(getpid()));
+      path = default_path;
+    }
+    const int fd = ::open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd < 0) {
+      return false;
+    }
+    // perf finds the dump by looking for an executable mapping of it.
+    const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    marker = mmap(nullptr, page_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (marker == MAP_FAILED) {
+      marker = nullptr;
+      ::close(fd);
+      return false;
+    }
+    file = fdopen(fd, "wb");
+    if (file == nullptr) {
+      munmap(marker, page_size);
+      marker = nullptr;
+      ::close(fd);
+      return false;
+    }
+#if defined(__x86_64__)
+    const uint32_t elf_mach = EM_X86_64;
+#elif defined(__aarch64__)
+    const uint32_t elf_mach = EM_AARCH64;
+#else
+    const uint32_t elf_mach = EM_NONE;
+#endif
+    write<uint32_t>(0x4A695444); // magic "JiTD"
+    write<uint32_t>(1); // version
+    write<uint32_t>(40); // header size
+    write<uint32_t>(elf_mach);
+    write<uint32_t>(0); // padding
+    write<uint32_t>(static_cast<uint32_t>(getpid()));
+    write<uint64_t>(timestamp());
+    write<uint64_t>(0); // flags
+    fflush(file);
+#endif
+    return file != nullptr;
+  }
+
+  /**
+   * Adds a code load record for a region of generated code.
+   * @param code The start of the region.
+   * @param size The size of the region in bytes.
+   * @param name The symbol name, see `perf_region_name`.
+   */
+  auto add(const void *code, size_t size, const std::string &name) noexcept -> void {
+#ifdef __linux__
+    if (file == nullptr) {
+      return;
+    }
+    const auto addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(code));
+    const auto record_size = static_cast<uint32_t>(16 + 8 + 4 * 8 + name.size() + 1 + size);
+    write<uint32_t>(0); // JIT_CODE_LOAD
+    write<uint32_t>(record_size);
+    write<uint64_t>(timestamp());
+    write<uint32_t>(static_cast<uint32_t>(getpid()));
+    write<uint32_t>(static_cast<uint32_t>(syscall(SYS_gettid)));
+    write<uint64_t>(addr); // vma
+    write<uint64_t>(addr); // code address
+    write<uint64_t>(size);
+    write<uint64_t>(code_index++);
+    fwrite(name.c_str(), 1, name.size() + 1, file);
+    fwrite(code, 1, size, file);
+    fflush(file);
+#endif
+  }
+
+  /**
+   * Closes the dump file.
+   */
+  auto close() noexcept -> void {
+#ifdef __linux__
+    if (marker != nullptr) {
+      munmap(marker, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+      marker = nullptr;
+    }
+#endif
+    if (file != nullptr) {
+      fclose(file);
+      file = nullptr;
+    }
+  }
+};
+
+/**
+ * Host hardware counters read around a run of the vm.
+ */
+struct HostCounterValues {
+  /// Host cpu cycles.
+  uint64_t cycles;
+
+  /// Host cache misses.
+  uint64_t cache_misses;
+};
+
+/**
+ * Counts host cycles and cache misses of the calling thread with `perf_event_open`.
+ * Unavailable on hosts other than Linux, or when `perf_event_paranoid` forbids it.
+ */
+class HostCounters {
+ private:
+  /// The group leader counting cycles, -1 if unavailable.
+  int cycles_fd = -1;
+
+  /// The group member counting cache misses, -1 if unavailable.
+  int misses_fd = -1;
+
+#ifdef __linux__
+  /**
+   * Opens a hardware counter of the calling thread.
+   * @param config The hardware event.
+   * @param group_fd The group leader, -1 to open a new group.
+   * @return The counter`s file descriptor, -1 on failure.
+   */
+  static auto open_counter(uint64_t config, int group_fd) noexcept -> int {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group_fd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+  }
+
+  /**
+   * Reads a counter.
+   * @param fd The counter`s file descriptor.
+   * @return The count, 0 if it can`t be read.
+   */
+  static auto read_counter(int fd) noexcept -> uint64_t {
+    uint64_t value = 0;
+    if (fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value)) {
+      return 0;
+    }
+    return value;
+  }
+#endif
+
+ public:
+  HostCounters() noexcept = default;
+  HostCounters(const HostCounters &) = delete;
+  HostCounters &operator=(const HostCounters &) = delete;
+
+  ~HostCounters() {
+    close();
+  }
+
+  /**
+   * Opens the counters.
+   * @return Whether at least the cycle counter is available.
+   */
+  auto open() noexcept -> bool {
+#ifdef __linux__
+    if (cycles_fd >= 0) {
+      return true;
+    }
+    cycles_fd = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (cycles_fd < 0) {
+      return false;
+    }
+    misses_fd = open_counter(PERF_COUNT_HW_CACHE_MISSES, cycles_fd);
+#endif
+    return cycles_fd >= 0;
+  }
+
+  /**
+   * Resets and starts counting.
+   */
+  auto start() noexcept -> void {
+#ifdef __linux__
+    if (cycles_fd < 0) {
+      return;
+    }
+    ioctl(cycles_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  /**
+   * Stops counting.
+   * @return The counts since the last `start`, zeros if the counters are unavailable.
+   */
+  auto stop() noexcept -> HostCounterValues {
+    HostCounterValues values{0, 0};
+#ifdef __linux__
+    if (cycles_fd < 0) {
+      return values;
+    }
+    ioctl(cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    values.cycles = read_counter(cycles_fd);
+    values.cache_misses = read_counter(misses_fd);
+#endif
+    return values;
+  }
+
+  /**
+   * Closes the counters.
+   */
+  auto close() noexcept -> void {
+#ifdef __linux__
+    if (misses_fd >= 0) {
+      ::close(misses_fd);
+    }
+    if (cycles_fd >= 0) {
+      ::close(cycles_fd);
+    }
+#endif
+    misses_fd = -1;
+    cycles_fd = -1;
+  }
+};
+
+#endif //ZAGROS_PERF
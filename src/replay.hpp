@@ -0,0 +1,232 @@
+#ifndef ZAGROS_REPLAY
+#define ZAGROS_REPLAY
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// Magic bytes at the beginning of a replay log.
+static const std::array<uint8_t, 4> REPLAY_LOG_MAGIC = {'Z', 'R', 'P', 'L'};
+
+/// Version of the replay log format.
+static const uint8_t REPLAY_LOG_VERSION = 1;
+
+/**
+ * Kinds of events crossing the boundary between a vm and its host.
+ */
+enum class ReplayEventKind : uint8_t {
+  /// An I/O callback was called, the argument is the I/O id.
+  IoCall,
+
+  /// An I/O callback returned, the argument is the I/O id.
+  IoReturn,
+
+  /// The host wrote an I/O memory byte, the argument is the address.
+  IoWrite,
+
+  /// The host read an I/O memory byte, the argument is the address.
+  IoRead,
+
+  /// An interrupt was delivered, the argument is the interrupt id.
+  Interrupt,
+
+  /// A guest read a performance counter with `PF`, the argument is the value it got.
+  Counter,
+
+  /// The host wrote a memory byte with `write_memory`, the argument is the address.
+  MemoryWrite
+};
+
+/**
+ * A single event of a replay log.
+ */
+struct ReplayEvent {
+  /// The number of instructions all cores retired when the event happened.
+  uint64_t stamp;
+
+  /// The argument of the event, see `ReplayEventKind`.
+  uint32_t arg;
+
+  /// The byte written or read, 0 for other kinds.
+  uint8_t value;
+
+  /// The kind of event.
+  ReplayEventKind kind;
+};
+
+/**
+ * A compact binary log of the events crossing the boundary between a vm and its host.
+ * A vm recording into the log captures I/O calls, the I/O memory bytes the host writes and reads, the memory
+ * bytes the host writes, interrupt arrivals and performance counter reads. A vm replaying the log feeds them back instead of calling the host,
+ * so a run can be reproduced exactly on another build of the vm.
+ *
+ * Every event is a kind byte followed by LEB128 varints: the zigzag encoded difference of its stamp to the
+ * previous event`s stamp and its argument, then the byte for `IoWrite`, `IoRead` and `MemoryWrite` events.
+ */
+class ReplayLog {
+ private:
+  /// The encoded log, starting with the magic and the version.
+  std::vector<uint8_t> bytes;
+
+  /// The stamp of the last recorded event.
+  uint64_t last_stamp = 0;
+
+  /// The position of the next event to read.
+  size_t cursor;
+
+  /// The stamp of the last read event.
+  uint64_t read_stamp = 0;
+
+  /**
+   * Appends an unsigned LEB128 varint.
+   * @param value The value.
+   */
+  auto put_varint(uint64_t value) -> void {
+    while (value >= 0x80) {
+      bytes.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+  }
+
+  /**
+   * Reads an unsigned LEB128 varint.
+   * @param at The position to read at, advanced past the varint.
+   * @param value The value read.
+   * @return Whether a complete varint was read.
+   */
+  auto get_varint(size_t &at, uint64_t &value) const noexcept -> bool {
+    value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      if (at >= bytes.size()) {
+        return false;
+      }
+      const auto byte = bytes[at++];
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Checks whether events of a kind carry a byte.
+   * @param kind The kind of event.
+   * @return Whether the byte follows the argument.
+   */
+  static auto has_value(ReplayEventKind kind) noexcept -> bool {
+    return kind == ReplayEventKind::IoWrite || kind == ReplayEventKind::IoRead || kind == ReplayEventKind::MemoryWrite;
+  }
+
+  /**
+   * Decodes the event at a position.
+   * @param at The position, advanced past the event.
+   * @param event The decoded event.
+   * @return Whether a well formed event was decoded.
+   */
+  auto decode(size_t &at, ReplayEvent &event) const noexcept -> bool {
+    if (at >= bytes.size() || bytes[at] > static_cast<uint8_t>(ReplayEventKind::MemoryWrite)) {
+      return false;
+    }
+    event.kind = static_cast<ReplayEventKind>(bytes[at++]);
+    uint64_t delta;
+    uint64_t arg;
+    if (!get_varint(at, delta) || !get_varint(at, arg)) {
+      return false;
+    }
+    const auto signed_delta = static_cast<int64_t>(delta >> 1) ^ -static_cast<int64_t>(delta & 1);
+    event.stamp = read_stamp + static_cast<uint64_t>(signed_delta);
+    event.arg = static_cast<uint32_t>(arg);
+    event.value = 0;
+    if (has_value(event.kind)) {
+      if (at >= bytes.size()) {
+        return false;
+      }
+      event.value = bytes[at++];
+    }
+    return true;
+  }
+
+ public:
+  /**
+   * Constructs an empty log.
+   */
+  ReplayLog() : bytes(REPLAY_LOG_MAGIC.begin(), REPLAY_LOG_MAGIC.end()), cursor(REPLAY_LOG_MAGIC.size() + 1) {
+    bytes.push_back(REPLAY_LOG_VERSION);
+  }
+
+  /**
+   * Constructs a log from its encoded bytes, e.g. read from a file.
+   * A log with a bad magic or version reads as empty.
+   * @param encoded The encoded log.
+   */
+  explicit ReplayLog(std::vector<uint8_t> encoded) : bytes(std::move(encoded)), cursor(REPLAY_LOG_MAGIC.size() + 1) {
+    if (bytes.size() < cursor || !std::equal(REPLAY_LOG_MAGIC.begin(), REPLAY_LOG_MAGIC.end(), bytes.begin()) ||
+        bytes[REPLAY_LOG_MAGIC.size()] != REPLAY_LOG_VERSION) {
+      bytes.assign(REPLAY_LOG_MAGIC.begin(), REPLAY_LOG_MAGIC.end());
+      bytes.push_back(REPLAY_LOG_VERSION);
+    }
+  }
+
+  /**
+   * Appends an event.
+   * @param kind The kind of event.
+   * @param stamp The number of instructions all cores retired when the event happened.
+   * @param arg The argument of the event.
+   * @param value The byte written or read, ignored for other kinds.
+   */
+  auto record(ReplayEventKind kind, uint64_t stamp, uint32_t arg, uint8_t value = 0) -> void {
+    const auto delta = static_cast<int64_t>(stamp - last_stamp);
+    last_stamp = stamp;
+    bytes.push_back(static_cast<uint8_t>(kind));
+    put_varint((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+    put_varint(arg);
+    if (has_value(kind)) {
+      bytes.push_back(value);
+    }
+  }
+
+  /**
+   * Gets the next event without consuming it.
+   * @param event The event.
+   * @return Whether there is a next event.
+   */
+  auto peek(ReplayEvent &event) const noexcept -> bool {
+    auto at = cursor;
+    return decode(at, event);
+  }
+
+  /**
+   * Consumes the next event.
+   * @param event The event.
+   * @return Whether there was a next event.
+   */
+  auto next(ReplayEvent &event) noexcept -> bool {
+    if (!decode(cursor, event)) {
+      return false;
+    }
+    read_stamp = event.stamp;
+    return true;
+  }
+
+  /**
+   * Starts reading from the first event again.
+   */
+  auto rewind() noexcept -> void {
+    cursor = REPLAY_LOG_MAGIC.size() + 1;
+    read_stamp = 0;
+  }
+
+  /**
+   * Gets the encoded log, e.g. to write it to a file.
+   * @return The encoded log.
+   */
+  auto get_bytes() const noexcept -> const std::vector<uint8_t> & {
+    return bytes;
+  }
+};
+
+#endif //ZAGROS_REPLAY
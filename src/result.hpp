@@ -50,6 +50,27 @@ enum class ZError {
   /// The operation failed because of illegal interrupt id.
   IllegalInterruptId,
 
+  /// The operation failed because of illegal core id.
+  IllegalCoreId,
+
+  /// The operation failed because of illegal performance counter id.
+  IllegalCounterId,
+
+  /// The vm stopped because it executed its instruction budget.
+  InstructionLimitReached,
+
+  /// The vm diverged from the replay log it is replaying.
+  ReplayDivergence,
+
+  /// The vm stopped at a breakpoint.
+  Breakpoint,
+
+  /// The vm stopped after a write to a watched memory range.
+  Watchpoint,
+
+  /// The operation failed because of an operand out of its range or a malformed data structure in memory.
+  IllegalOperand,
+
   /// System should successfully halted.
   SystemHalt
 };
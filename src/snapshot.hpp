@@ -214,6 +214,14 @@ class MemorySnapshot {
     return arr;
   }
 
+  /**
+   * Gets the memory`s data without copying it.
+   * @return The first byte of the data, valid as long as the snapshot.
+   */
+  const uint8_t *data() const noexcept {
+    return arr.data();
+  }
+
   virtual std::string toString() const {
     std::stringstream os;
     os << "{ arr: [";
@@ -393,16 +401,104 @@ class CoreSnapshot {
 
 };
 
+/**
+ * A snapshot of the call statistics of a single I/O id.
+ * Latencies are in host cycles as read by `cycle_now`.
+ */
+class IoStatsSnapshot {
+ private:
+  /// The number of calls.
+  uint64_t calls;
+
+  /// The median latency.
+  uint64_t p50;
+
+  /// The 99th percentile latency.
+  uint64_t p99;
+
+  /// The 99.9th percentile latency.
+  uint64_t p999;
+
+  /// The largest latency.
+  uint64_t max;
+
+ public:
+  /**
+   * Default constructor
+   */
+  IoStatsSnapshot() : calls{}, p50{}, p99{}, p999{}, max{} {
+  }
+
+  /**
+   * Constructs a snapshot of the statistics of an I/O id.
+   * @param calls The number of calls.
+   * @param p50 The median latency.
+   * @param p99 The 99th percentile latency.
+   * @param p999 The 99.9th percentile latency.
+   * @param max The largest latency.
+   */
+  IoStatsSnapshot(uint64_t calls, uint64_t p50, uint64_t p99, uint64_t p999, uint64_t max) noexcept
+      : calls{calls}, p50{p50}, p99{p99}, p999{p999}, max{max} {
+  }
+
+  /**
+   * Gets the number of calls.
+   */
+  uint64_t get_calls() const noexcept {
+    return calls;
+  }
+
+  /**
+   * Gets the median latency.
+   */
+  uint64_t get_p50() const noexcept {
+    return p50;
+  }
+
+  /**
+   * Gets the 99th percentile latency.
+   */
+  uint64_t get_p99() const noexcept {
+    return p99;
+  }
+
+  /**
+   * Gets the 99.9th percentile latency.
+   */
+  uint64_t get_p999() const noexcept {
+    return p999;
+  }
+
+  /**
+   * Gets the largest latency.
+   */
+  uint64_t get_max() const noexcept {
+    return max;
+  }
+
+  virtual std::string toString() const {
+    std::stringstream os;
+    os << "{ calls: " << calls << " p50: " << p50 << " p99: " << p99 << " p999: " << p999 << " max: " << max << " }";
+    return os.str();
+  }
+};
+
 class IoTableSnapshot {
   /// The table`s callback descriptions
   const std::vector<std::string> arr;
 
+  /// The table`s call statistics, empty if statistics are disabled
+  const std::vector<IoStatsSnapshot> stats;
+
  public:
 /**
  * Constructs a snapshot of the io table.
  * @param data The table`s arr.
+ * @param stats The table`s call statistics.
  */
-  explicit IoTableSnapshot(std::vector<std::string> arr) noexcept: arr(std::move(arr)) {}
+  explicit IoTableSnapshot(std::vector<std::string> arr,
+                           std::vector<IoStatsSnapshot> stats = std::vector<IoStatsSnapshot>{}) noexcept
+      : arr(std::move(arr)), stats(std::move(stats)) {}
 
   /**
    * Returns the table`s arr.
@@ -412,6 +508,14 @@ class IoTableSnapshot {
     return arr;
   }
 
+  /**
+   * Returns the table`s call statistics, indexed by I/O id.
+   * @return The statistics, empty if statistics are disabled.
+   */
+  const std::vector<IoStatsSnapshot> &get_stats() const noexcept {
+    return stats;
+  }
+
   virtual std::string toString() const {
     std::stringstream os;
     os << "arr: [";
@@ -420,6 +524,13 @@ class IoTableSnapshot {
       os << arr[i] << ", ";
     }
     os << arr[i] << "]";
+    if (!stats.empty()) {
+      os << " stats: [";
+      for (i = 0; i < stats.size() - 1; ++i) {
+        os << stats[i].toString() << ", ";
+      }
+      os << stats[i].toString() << "]";
+    }
     return os.str();
   }
 };
@@ -0,0 +1,86 @@
+#ifndef ZAGROS_SORT
+#define ZAGROS_SORT
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "instruction_mode.hpp"
+#include "zagros_configuration.h"
+
+/**
+ * Maps a word to a key whose unsigned order is the word`s order in an operation mode,
+ * so the same sort and search work for all modes.
+ * Signed words get their sign bit flipped, floats get all bits flipped if negative and the sign bit flipped
+ * otherwise, which orders -0 before +0 and NaNs at the ends.
+ * @param word The word.
+ * @param mode The operation mode.
+ * @return The key.
+ */
+inline auto sort_key(uint32_t word, OpMode mode) noexcept -> uint32_t {
+  switch (mode) {
+    case OpMode::SIGNED: {
+      return word ^ 0x80000000u;
+    }
+    case OpMode::UNSIGNED: {
+      return word;
+    }
+    case OpMode::FLOAT: {
+      return (word & 0x80000000u) != 0 ? ~word : word ^ 0x80000000u;
+    }
+  }
+  return word;
+}
+
+/**
+ * Maps a key made by `sort_key` back to its word.
+ * @param key The key.
+ * @param mode The operation mode.
+ * @return The word.
+ */
+inline auto sort_word(uint32_t key, OpMode mode) noexcept -> uint32_t {
+  switch (mode) {
+    case OpMode::SIGNED: {
+      return key ^ 0x80000000u;
+    }
+    case OpMode::UNSIGNED: {
+      return key;
+    }
+    case OpMode::FLOAT: {
+      return (key & 0x80000000u) != 0 ? key ^ 0x80000000u : ~key;
+    }
+  }
+  return key;
+}
+
+/**
+ * Sorts keys in place. Small arrays are sorted by `std::sort`, an introsort finishing with insertion sort,
+ * larger ones by a least significant digit radix sort in four byte passes.
+ * @param keys The keys.
+ */
+inline auto sort_keys(std::vector<uint32_t> &keys) -> void {
+  if (keys.size() < RADIX_SORT_MIN_SIZE) {
+    std::sort(keys.begin(), keys.end());
+    return;
+  }
+  std::vector<uint32_t> scratch(keys.size());
+  for (uint32_t shift = 0; shift < 32; shift += 8) {
+    std::array<size_t, 257> offsets{};
+    for (const auto key : keys) {
+      offsets[((key >> shift) & 0xFF) + 1] += 1;
+    }
+    // Skip passes where all keys share the digit.
+    if (offsets[((keys[0] >> shift) & 0xFF) + 1] == keys.size()) {
+      continue;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+      offsets[i] += offsets[i - 1];
+    }
+    for (const auto key : keys) {
+      scratch[offsets[(key >> shift) & 0xFF]++] = key;
+    }
+    keys.swap(scratch);
+  }
+}
+
+#endif //ZAGROS_SORT
@@ -12,17 +12,17 @@
 */
 class DataStack {
  private:
+  /// The stack`s top index, ahead of the data so it sits next to the bottom of the stack.
+  size_t top = 0;
+
   /// The stack`s data.
   std::array<Cell, DATA_STACK_SIZE> arr;
-
-  /// The stack`s top index.
-  size_t top = 0;
  public:
 
   /**
    * Constructor
    */
-  DataStack() noexcept: arr(), top(0) {}
+  DataStack() noexcept: top(0), arr() {}
 
   /**
    * Guarantees that stack is safe for n `pops` first and then m `pushes` later.
@@ -56,6 +56,44 @@ class DataStack {
     return arr[--top];
   }
 
+  /**
+   * Reads the top value of the stack without popping it.
+   * @return The top value, or the bottom slot if the stack is empty.
+   */
+  auto peek() const noexcept -> Cell {
+    return arr[top == 0 ? 0 : top - 1];
+  }
+
+  /**
+   * Gets the number of values on the stack.
+   * @return The stack`s depth.
+   */
+  auto depth() const noexcept -> size_t {
+    return top;
+  }
+
+  /**
+   * Removes values from the bottom of the stack, e.g. to spill them into memory.
+   * @param out Receives the values, bottom first.
+   * @param n The number of values, at most the stack`s depth.
+   */
+  auto take_bottom(Cell *out, size_t n) noexcept -> void {
+    std::copy_n(arr.begin(), n, out);
+    std::copy(arr.begin() + n, arr.begin() + top, arr.begin());
+    top -= n;
+  }
+
+  /**
+   * Puts values back under the bottom of the stack, e.g. to fill them from memory.
+   * @param in The values, bottom first.
+   * @param n The number of values, at most the stack`s free space.
+   */
+  auto put_bottom(const Cell *in, size_t n) noexcept -> void {
+    std::copy_backward(arr.begin(), arr.begin() + top, arr.begin() + top + n);
+    std::copy_n(in, n, arr.begin());
+    top += n;
+  }
+
   /**
    * Clears the stack.
    */
@@ -76,17 +114,17 @@ class DataStack {
  */
 class AddressStack {
  private:
+  /// The stack`s top index, ahead of the data so it sits next to the bottom of the stack.
+  size_t top = 0;
+
   /// The stack`s data.
   std::array<Cell, ADDRESS_STACK_SIZE> arr;
-
-  /// The stack`s top index.
-  size_t top = 0;
  public:
 
   /**
   * Constructor
   */
-  AddressStack() noexcept: arr(), top(0) {}
+  AddressStack() noexcept: top(0), arr() {}
 
   /**
    * Pushes a value onto the stack.
@@ -113,6 +151,36 @@ class AddressStack {
     return {ZError::None, value};
   }
 
+  /**
+   * Gets the number of values on the stack.
+   * @return The stack`s depth.
+   */
+  auto depth() const noexcept -> size_t {
+    return top;
+  }
+
+  /**
+   * Removes values from the bottom of the stack, e.g. to spill them into memory.
+   * @param out Receives the values, bottom first.
+   * @param n The number of values, at most the stack`s depth.
+   */
+  auto take_bottom(Cell *out, size_t n) noexcept -> void {
+    std::copy_n(arr.begin(), n, out);
+    std::copy(arr.begin() + n, arr.begin() + top, arr.begin());
+    top -= n;
+  }
+
+  /**
+   * Puts values back under the bottom of the stack, e.g. to fill them from memory.
+   * @param in The values, bottom first.
+   * @param n The number of values, at most the stack`s free space.
+   */
+  auto put_bottom(const Cell *in, size_t n) noexcept -> void {
+    std::copy_backward(arr.begin(), arr.begin() + top, arr.begin() + top + n);
+    std::copy_n(in, n, arr.begin());
+    top += n;
+  }
+
   /**
    * Clears the stack.
    */
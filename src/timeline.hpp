@@ -0,0 +1,238 @@
+#ifndef ZAGROS_TIMELINE
+#define ZAGROS_TIMELINE
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "zagros_configuration.h"
+
+/**
+ * Kinds of events recorded in a scheduling timeline.
+ */
+enum class TimelineEventKind : uint8_t {
+  /// A core was activated by `AC`.
+  CoreActivated,
+
+  /// A core was paused by `PC`.
+  CorePaused,
+
+  /// A core suspended itself with `SC`.
+  CoreSuspended,
+
+  /// The scheduler switched to a core.
+  CoreScheduled,
+
+  /// The scheduler switched away from a core, or the vm stopped.
+  CoreDescheduled,
+
+  /// An interrupt handler was entered.
+  InterruptEnter,
+
+  /// An interrupt handler was exited.
+  InterruptExit,
+
+  /// An I/O callback was called.
+  IoEnter,
+
+  /// An I/O callback returned.
+  IoExit
+};
+
+/**
+ * A single event of a scheduling timeline.
+ */
+struct TimelineEvent {
+  /// The host cycle of the event.
+  uint64_t ts;
+
+  /// The argument of the event: the target core, the interrupt id or the I/O id.
+  uint32_t arg;
+
+  /// The core the event happened on.
+  uint8_t core;
+
+  /// The kind of event.
+  TimelineEventKind kind;
+};
+
+/**
+ * Records core scheduling, interrupt and I/O events of a vm and writes them in the Chrome trace event JSON format,
+ * viewable in `chrome://tracing` or Perfetto. Each core is shown as a thread.
+ * Events are buffered in a fixed size buffer and written out in batches whenever it fills up.
+ */
+class TimelineRecorder {
+ private:
+  /// The buffered events.
+  std::vector<TimelineEvent> events;
+
+  /// The maximum number of buffered events.
+  size_t capacity;
+
+  /// The stream the trace is written to.
+  std::ostream &out;
+
+  /// The number of host cycles per microsecond, the time unit of the trace format.
+  double cycles_per_us;
+
+  /// Whether the opening of the trace has been written.
+  bool started = false;
+
+  /// Whether an event has been written, so the next one needs a separator.
+  bool written = false;
+
+  /// Whether a scheduling slice is open on each core.
+  std::array<bool, CORE_COUNT> scheduled{};
+
+  /**
+   * Writes the separator between two events.
+   */
+  auto separate() -> void {
+    if (written) {
+      out << ",\n";
+    }
+    written = true;
+  }
+
+  /**
+   * Writes the opening of the trace and the names of the cores.
+   */
+  auto start() -> void {
+    started = true;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < CORE_COUNT; ++i) {
+      separate();
+      out << R"({"name":"thread_name","ph":"M","pid":0,"tid":)" << i
+          << R"(,"args":{"name":"core )" << i << "\"}}";
+    }
+  }
+
+  /**
+   * Writes a single event.
+   * @param event The event.
+   */
+  auto write(const TimelineEvent &event) -> void {
+    // Every kind sets both, the initial values only keep the compiler sure of it.
+    const char *name = "unknown";
+    const char *phase = "i";
+    switch (event.kind) {
+      case TimelineEventKind::CoreActivated: {
+        name = "activate core";
+        phase = "i";
+        break;
+      }
+      case TimelineEventKind::CorePaused: {
+        name = "pause core";
+        phase = "i";
+        break;
+      }
+      case TimelineEventKind::CoreSuspended: {
+        name = "suspend";
+        phase = "i";
+        break;
+      }
+      case TimelineEventKind::CoreScheduled: {
+        name = "running";
+        phase = "B";
+        break;
+      }
+      case TimelineEventKind::CoreDescheduled: {
+        name = "running";
+        phase = "E";
+        break;
+      }
+      case TimelineEventKind::InterruptEnter: {
+        name = "interrupt";
+        phase = "B";
+        break;
+      }
+      case TimelineEventKind::InterruptExit: {
+        name = "interrupt";
+        phase = "E";
+        break;
+      }
+      case TimelineEventKind::IoEnter: {
+        name = "io";
+        phase = "B";
+        break;
+      }
+      case TimelineEventKind::IoExit: {
+        name = "io";
+        phase = "E";
+        break;
+      }
+    }
+    separate();
+    out << R"({"name":")" << name << R"(","ph":")" << phase << R"(","pid":0,"tid":)"
+        << static_cast<int>(event.core) << R"(,"ts":)" << static_cast<double>(event.ts) / cycles_per_us;
+    if (phase[0] == 'i') {
+      out << R"(,"s":"t")";
+    }
+    if (event.kind != TimelineEventKind::CoreScheduled && event.kind != TimelineEventKind::CoreDescheduled) {
+      out << R"(,"args":{"id":)" << event.arg << "}";
+    }
+    out << "}";
+  }
+
+ public:
+  /**
+   * Constructs a recorder.
+   * @param out The stream to write the trace to, must outlive the recorder.
+   * @param cycles_per_us The number of host cycles per microsecond, 1 keeps raw cycles as the time axis.
+   * @param capacity The number of events to buffer before writing them out.
+   */
+  explicit TimelineRecorder(std::ostream &out, double cycles_per_us = 1.0,
+                            size_t capacity = TIMELINE_BUFFER_SIZE)
+      : capacity(capacity == 0 ? 1 : capacity), out(out), cycles_per_us(cycles_per_us) {
+    events.reserve(this->capacity);
+  }
+
+  TimelineRecorder(const TimelineRecorder &) = delete;
+  TimelineRecorder &operator=(const TimelineRecorder &) = delete;
+
+  /**
+   * Records an event, writing out the buffered events first if the buffer is full.
+   * Unmatched scheduling events are dropped so every slice on the timeline is well formed.
+   * @param ts The host cycle of the event.
+   * @param core The core the event happened on.
+   * @param kind The kind of event.
+   * @param arg The argument of the event.
+   */
+  auto record(uint64_t ts, size_t core, TimelineEventKind kind, uint32_t arg = 0) -> void {
+    if (kind == TimelineEventKind::CoreScheduled || kind == TimelineEventKind::CoreDescheduled) {
+      const auto open = kind == TimelineEventKind::CoreScheduled;
+      if (scheduled[core] == open) {
+        return;
+      }
+      scheduled[core] = open;
+    }
+    if (events.size() == capacity) {
+      flush();
+    }
+    events.push_back(TimelineEvent{ts, arg, static_cast<uint8_t>(core), kind});
+  }
+
+  /**
+   * Writes out the buffered events.
+   */
+  auto flush() -> void {
+    if (!started) {
+      start();
+    }
+    for (const auto &event : events) {
+      write(event);
+    }
+    events.clear();
+  }
+
+  /**
+   * Writes out the buffered events and closes the trace. The recorder must not be used afterwards.
+   */
+  auto finish() -> void {
+    flush();
+    out << "\n]}\n";
+    out.flush();
+  }
+};
+
+#endif //ZAGROS_TIMELINE
@@ -20,6 +20,28 @@
 #include "interrupt.hpp"
 #include "io.h"
 #include "core.hpp"
+#include "disassembler.hpp"
+#include "perf.hpp"
+#include "clock.hpp"
+#include "metrics.hpp"
+#include "timeline.hpp"
+#include "replay.hpp"
+#include "heap.hpp"
+#include "hash_table.hpp"
+
+#ifdef ZAGROS_TAIL_CALL_DISPATCH
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::musttail)
+#define ZAGROS_MUSTTAIL [[clang::musttail]]
+#elif __has_cpp_attribute(gnu::musttail)
+#define ZAGROS_MUSTTAIL [[gnu::musttail]]
+#endif
+#endif
+#ifndef ZAGROS_MUSTTAIL
+// Without guaranteed tail calls every instruction would grow the host stack, so refuse to build.
+#error "ZAGROS_TAIL_CALL_DISPATCH needs a compiler supporting [[clang::musttail]] or [[gnu::musttail]]"
+#endif
+#endif
 
 
 /**
@@ -27,23 +49,192 @@
  */
 class VM {
  private:
-  /// The memory.
-  Memory mem;
+  // The scheduler state every dispatch reads comes first, then the cores.
+  // The memory comes last, so its 64 KB don`t separate the hot state.
 
-  /// The interrupt table.
-  InterruptTable int_table;
+  /// The current core.
+  size_t cur_core_id = 0;
+
+  /// The number of instructions left before a budgeted run stops with `InstructionLimitReached`
+  uint64_t budget = 0;
+
+  /// Whether the last run stopped because its instruction budget was spent, so the next run continues the round
+  /// robin instead of starting over at core 0
+  bool budget_spent = false;
+
+  /// The edge coverage bitmap of `COVERAGE_MAP_SIZE` bytes, `nullptr` if disabled
+  uint8_t *coverage_map = nullptr;
+
+  /// Whether or not interrupts are enabled
+  bool int_enabled = false;
+
+  /// Whether or not executed instructions are recorded in the cores` execution traces
+  bool trace_enabled = false;
 
   /// The cores.
   std::array<Core, CORE_COUNT>
       cores;
 
+  /// The interrupt table.
+  InterruptTable int_table;
+
   IoTable io_table;
 
-  /// The current core.
-  size_t cur_core_id = 0;
+  /// The execution traces dumped when the VM last stopped on an error
+  std::vector<uint8_t> trace_dump;
 
-  /// Whether or not interrupts are enabled
-  bool int_enabled = false;
+  /// The host hardware counters read around `run`, `nullptr` if disabled
+  HostCounters *host_counters = nullptr;
+
+  /// The host hardware counts of the last `run`
+  HostCounterValues host_counter_values{0, 0};
+
+  /// The number of host cycles spent running
+  uint64_t run_cycles = 0;
+
+  /// The number of times the scheduler switched to another core
+  uint64_t core_switches = 0;
+
+  /// The number of interrupts triggered while interrupts were enabled
+  uint64_t interrupts_delivered = 0;
+
+  /// The number of interrupts triggered while interrupts were disabled
+  uint64_t interrupts_masked = 0;
+
+  /// The number of I/O calls
+  uint64_t io_calls = 0;
+
+  /// The number of I/O calls and accesses with an illegal I/O id or address
+  uint64_t io_errors = 0;
+
+  /// The number of runs stopped by each error kind
+  std::array<uint64_t, ZERROR_COUNT> stops{};
+
+  /// The recorder of the scheduling timeline, `nullptr` if disabled
+  TimelineRecorder *timeline = nullptr;
+
+  /// Whether the core that stopped at a breakpoint executes the original instruction instead next time
+  bool resuming = false;
+
+  /// The core to step over a breakpoint on
+  size_t resume_core = 0;
+
+  /// The address of the breakpoint to step over
+  uint32_t resume_ip = 0;
+
+  /// The queue I/O requests go to instead of the callbacks, `nullptr` if disabled
+  IoRequestQueue *io_queue = nullptr;
+
+  /// The address of the I/O memory copied into each queued request
+  size_t io_payload_addr = 0;
+
+  /// The number of I/O memory bytes copied into each queued request
+  size_t io_payload_len = 0;
+
+  /// The log the host boundary events are recorded into, `nullptr` if disabled
+  ReplayLog *replay_recorder = nullptr;
+
+  /// The log the host boundary events are replayed from, `nullptr` if disabled
+  ReplayLog *replay_source = nullptr;
+
+  /// The guest heap used by `AL`, `FR` and `AR`
+  Heap heap;
+
+  /// The twiddle factors used by `FT`, derived data kept across runs
+  TwiddleCache twiddles;
+
+  /// The memory, on the heap so the vm moves cheaply.
+  MemoryBox mem;
+
+  /**
+   * Gets the stamp of a replay event.
+   * @return The number of instructions all cores retired.
+   */
+  auto replay_stamp() const noexcept -> uint64_t {
+    uint64_t retired = 0;
+    for (const auto &core : cores) {
+      retired += core.retired;
+    }
+    return retired;
+  }
+
+  /**
+   * Applies a logged host access to memory.
+   * @param event The event, `IoWrite` and `MemoryWrite` events write their byte, others do nothing.
+   */
+  auto replay_access(const ReplayEvent &event) noexcept -> void {
+    if (event.kind == ReplayEventKind::IoWrite) {
+      mem->write_io_byte(event.arg, event.value);
+    } else if (event.kind == ReplayEventKind::MemoryWrite) {
+      mem->write_block(event.arg, &event.value, 1);
+    }
+  }
+
+  /**
+   * Applies the logged host writes to memory that happened up to now outside of I/O callbacks.
+   */
+  auto replay_writes() noexcept -> void {
+    const auto now = replay_stamp();
+    ReplayEvent event{};
+    while (replay_source->peek(event) && event.stamp <= now &&
+        (event.kind == ReplayEventKind::IoWrite || event.kind == ReplayEventKind::IoRead ||
+            event.kind == ReplayEventKind::MemoryWrite)) {
+      replay_source->next(event);
+      replay_access(event);
+    }
+  }
+
+  /**
+   * Consumes the next logged event, which must match the event the vm is at.
+   * @param kind The kind of event.
+   * @param arg The argument of the event, ignored for `Counter` events.
+   * @return The logged event if it matched, `ReplayDivergence` otherwise.
+   */
+  auto replay_next(ReplayEventKind kind, uint32_t arg) noexcept -> std::pair<ZError, ReplayEvent> {
+    replay_writes();
+    ReplayEvent event{};
+    if (!replay_source->next(event) || event.kind != kind || event.stamp != replay_stamp() ||
+        (kind != ReplayEventKind::Counter && event.arg != arg)) {
+      return {ZError::ReplayDivergence, event};
+    }
+    return {ZError::None, event};
+  }
+
+  /**
+   * Replays an I/O call: applies the host writes to memory the callback did instead of calling it.
+   * @param io_id The I/O id.
+   * @return Unit if the call matched the log, `ReplayDivergence` otherwise.
+   */
+  auto replay_io_call(uint32_t io_id) noexcept -> std::pair<ZError, Unit> {
+    const auto call_err = std::get<0>(replay_next(ReplayEventKind::IoCall, io_id));
+    if (call_err != ZError::None) {
+      return {call_err, Unit{}};
+    }
+    ReplayEvent event{};
+    while (replay_source->next(event)) {
+      if (event.kind == ReplayEventKind::IoReturn) {
+        return {ZError::None, Unit{}};
+      }
+      replay_access(event);
+    }
+    return {ZError::ReplayDivergence, Unit{}};
+  }
+
+  /**
+   * Counts a branch in the edge coverage bitmap, the way AFL instruments basic block transitions.
+   * @param from The address of the branch instruction.
+   * @param to The address the branch continues at.
+   */
+  auto record_edge(uint32_t from, uint32_t to) noexcept -> void {
+    if (coverage_map == nullptr) {
+      return;
+    }
+    // Spread the addresses over the map, shift one side so A->B and B->A differ.
+    const auto edge = ((from * 2654435761u) >> 1) ^ (to * 2654435761u);
+    auto &hits = coverage_map[edge & (COVERAGE_MAP_SIZE - 1)];
+    // Never wrap back to 0, so a hot edge isn`t seen as not covered.
+    hits += hits == 255 ? 0 : 1;
+  }
 
   /**
    * Selects the next active core and sets the `cur_core_id` instance variable.
@@ -53,21 +244,186 @@ class VM {
       return;
     }
 
+    const auto prev_core_id = cur_core_id;
+
     // Look from current core to the end of the array
-    for (size_t next = cur_core_id + 1; next < CORE_COUNT; next++) {
+    for (size_t next = prev_core_id + 1; next < CORE_COUNT; next++) {
       if (cores[next].active) {
         cur_core_id = next;
         break;
       }
     }
 
-    // Look from the beginning of the array to the current core
-    for (size_t next = 0; next < cur_core_id; next++) {
+    // Look from the beginning of the array to the current core, if no later core is active
+    if (cur_core_id == prev_core_id) {
+      for (size_t next = 0; next < prev_core_id; next++) {
+        if (cores[next].active) {
+          cur_core_id = next;
+          break;
+        }
+      }
+    }
+
+    if (prev_core_id != cur_core_id) {
+      core_switches += 1;
+      if (timeline != nullptr) {
+        const auto now = cycle_now();
+        timeline->record(now, prev_core_id, TimelineEventKind::CoreDescheduled);
+        timeline->record(now, cur_core_id, TimelineEventKind::CoreScheduled);
+      }
+    }
+  }
+
+  /**
+   * Selects the first active core to start a run at. There is no core to switch away from, so this isn`t counted
+   * as a core switch.
+   */
+  auto sel_first_core() noexcept -> void {
+    // Keep the last core if none is active, like `sel_next_core` keeps the current one.
+    cur_core_id = CORE_COUNT - 1;
+    for (size_t next = 0; next < CORE_COUNT; next++) {
       if (cores[next].active) {
         cur_core_id = next;
         break;
       }
     }
+    if (timeline != nullptr) {
+      timeline->record(cycle_now(), cur_core_id, TimelineEventKind::CoreScheduled);
+    }
+  }
+
+  /**
+   * Writes cells spilled from a stack into memory as words.
+   * @param addr The memory address to write at.
+   * @param cells The cells.
+   * @param n The number of cells, at most `STACK_SPILL_BLOCK`.
+   */
+  auto spill_cells(size_t addr, const Cell *cells, size_t n) noexcept -> void {
+    std::array<uint8_t, STACK_SPILL_BLOCK * 4> bytes;
+    for (size_t i = 0; i < n; ++i) {
+      const auto cell_bytes = cells[i].to_bytes();
+      std::copy(cell_bytes.begin(), cell_bytes.end(), bytes.begin() + i * 4);
+    }
+    mem->write_block(addr, bytes.data(), n * 4);
+  }
+
+  /**
+   * Reads cells spilled from a stack back from memory.
+   * @param addr The memory address to read at.
+   * @param cells Receives the cells.
+   * @param n The number of cells, at most `STACK_SPILL_BLOCK`.
+   */
+  auto fill_cells(size_t addr, Cell *cells, size_t n) const noexcept -> void {
+    std::array<uint8_t, STACK_SPILL_BLOCK * 4> bytes;
+    mem->read_block(addr, bytes.data(), n * 4);
+    for (size_t i = 0; i < n; ++i) {
+      cells[i] = Cell{std::array<uint8_t, 4>{bytes[i * 4], bytes[i * 4 + 1], bytes[i * 4 + 2], bytes[i * 4 + 3]}};
+    }
+  }
+
+  /**
+   * Spills the bottom of a core`s data stack into its spill region until the pushes fit,
+   * then fills it back from the region until the pops are there.
+   * @param core The core.
+   * @param pops The number of pops to be performed.
+   * @param pushes The number of pushes to be performed.
+   * @return Success if the stack is safe now, ZError otherwise.
+   */
+  auto spill_data(Core &core, size_t pops, size_t pushes) noexcept -> std::pair<ZError, Unit> {
+    std::array<Cell, STACK_SPILL_BLOCK> cells;
+    while (core.data.depth() + pushes > DATA_STACK_SIZE) {
+      const auto n = std::min({STACK_SPILL_BLOCK, core.data.depth(),
+                               static_cast<size_t>(core.data_spill_cells - core.data_spilled)});
+      if (n == 0) {
+        return {ZError::DataStackOverflow, Unit{}};
+      }
+      core.data.take_bottom(cells.data(), n);
+      spill_cells(core.data_spill_base + core.data_spilled * 4, cells.data(), n);
+      core.data_spilled += n;
+    }
+    while (core.data.depth() < pops) {
+      const auto n = std::min({STACK_SPILL_BLOCK, DATA_STACK_SIZE - core.data.depth() - pushes,
+                               static_cast<size_t>(core.data_spilled)});
+      if (n == 0) {
+        return {ZError::DataStackUnderflow, Unit{}};
+      }
+      core.data_spilled -= n;
+      fill_cells(core.data_spill_base + core.data_spilled * 4, cells.data(), n);
+      core.data.put_bottom(cells.data(), n);
+    }
+    return core.data.guard(pops, pushes);
+  }
+
+  /**
+   * Guarantees that a core`s data stack is safe for n `pops` first and then m `pushes` later,
+   * spilling into or filling from memory if the core has a spill region.
+   * @param core The core.
+   * @param pops The number of pops to be performed.
+   * @param pushes The number of pushes to be performed.
+   * @return Success if the stack is safe, ZError otherwise.
+   */
+  auto guard_data(Core &core, size_t pops, size_t pushes) noexcept -> std::pair<ZError, Unit> {
+    const auto guard_result = core.data.guard(pops, pushes);
+    if (std::get<0>(guard_result) == ZError::None || core.data_spill_cells == 0) {
+      return guard_result;
+    }
+    return spill_data(core, pops, pushes);
+  }
+
+  /**
+   * Checks whether the guest heap lies in a core`s segment. The heap is shared by all cores, so a core may only
+   * use it if it is its own.
+   * @param core The core.
+   * @return Whether the heap lies in the segment.
+   */
+  auto heap_in_segment(const Core &core) const noexcept -> bool {
+    return heap.is_inside(core.seg_base, static_cast<uint64_t>(core.seg_base) + core.seg_limit);
+  }
+
+  /**
+   * Translates an array of words in a core`s segment to a memory address.
+   * @param core The core.
+   * @param addr The address of the array in the segment.
+   * @param count The number of words.
+   * @return The memory address of the array, or `MEMORY_SIZE` if it is outside the segment.
+   */
+  static auto translate_words(const Core &core, uint32_t addr, uint64_t count) noexcept -> size_t {
+    // Clamp the count, so its size can`t wrap around, a clamped array never fits anyway.
+    return core.translate(addr, static_cast<size_t>(std::min<uint64_t>(count, MEMORY_SIZE)) * 4);
+  }
+
+  /**
+   * Pushes onto a core`s address stack, spilling its bottom into memory first if it is full
+   * and the core has a spill region.
+   * @param core The core.
+   * @param value The value to be pushed.
+   * @return Success if the operation is successful, ZError otherwise.
+   */
+  auto push_address(Core &core, Cell value) noexcept -> std::pair<ZError, Unit> {
+    if (core.addrs.depth() == ADDRESS_STACK_SIZE && core.addrs_spilled < core.addrs_spill_cells) {
+      std::array<Cell, STACK_SPILL_BLOCK> cells;
+      const auto n = std::min(STACK_SPILL_BLOCK, static_cast<size_t>(core.addrs_spill_cells - core.addrs_spilled));
+      core.addrs.take_bottom(cells.data(), n);
+      spill_cells(core.addrs_spill_base + core.addrs_spilled * 4, cells.data(), n);
+      core.addrs_spilled += n;
+    }
+    return core.addrs.push(value);
+  }
+
+  /**
+   * Pops off a core`s address stack, filling it from memory first if it is empty and the core spilled before.
+   * @param core The core.
+   * @return The value if the operation is successful, ZError otherwise.
+   */
+  auto pop_address(Core &core) noexcept -> std::pair<ZError, Cell> {
+    if (core.addrs.depth() == 0 && core.addrs_spilled != 0) {
+      std::array<Cell, STACK_SPILL_BLOCK> cells;
+      const auto n = std::min(STACK_SPILL_BLOCK, static_cast<size_t>(core.addrs_spilled));
+      core.addrs_spilled -= n;
+      fill_cells(core.addrs_spill_base + core.addrs_spilled * 4, cells.data(), n);
+      core.addrs.put_bottom(cells.data(), n);
+    }
+    return core.addrs.pop();
   }
 
   /**
@@ -100,7 +456,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 push.
-    const auto guard_result = core.data.guard(0, 1);
+    const auto guard_result = guard_data(core, 0, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -109,8 +465,8 @@ class VM {
 
     // Get the addrs to look for the value.
     const auto cell_addr = core.ip + addr_offset;
-    // Read the value from the memory.
-    const auto read_result = mem.template read_bytes<S>(cell_addr);
+    // Read the value from the core`s segment.
+    const auto read_result = mem->template read_bytes<S>(core.translate(cell_addr, S));
     const auto read_err = std::get<0>(read_result);
     const auto cell = std::get<1>(read_result);
     if (read_err != ZError::None) {
@@ -166,7 +522,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop and 1 push.
-    const auto guard_result = core.data.guard(1, 1);
+    const auto guard_result = guard_data(core, 1, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -175,8 +531,8 @@ class VM {
 
     // Get the addrs to look for the value.
     const auto cell_addr = core.data.pop();
-    // Read the value from the memory.
-    const auto read_result = mem.template read_bytes<S>(cell_addr.to_size());
+    // Read the value from the core`s segment.
+    const auto read_result = mem->template read_bytes<S>(core.translate(cell_addr.to_size(), S));
     const auto read_err = std::get<0>(read_result);
     const auto cell = std::get<1>(read_result);
     if (read_err != ZError::None) {
@@ -230,7 +586,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops.
-    const auto guard_result = core.data.guard(2, 0);
+    const auto guard_result = guard_data(core, 2, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -242,8 +598,8 @@ class VM {
     // Get the value to store.
     const auto cell = core.data.pop();
 
-    // Write the value to the memory.
-    const auto write_result = mem.template write_bytes<S>(cell_addr.to_size(), cell);
+    // Write the value to the core`s segment.
+    const auto write_result = mem->template write_bytes<S>(core.translate(cell_addr.to_size(), S), cell);
     const auto write_err = std::get<0>(write_result);
 
     if (write_err != ZError::None) {
@@ -255,6 +611,11 @@ class VM {
     // Set the operation mode to 'SIGNED'
     core.op_mode = OpMode::SIGNED;
 
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
     return {ZError::None, Unit{}};
   }
 
@@ -291,7 +652,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop and 2 pushes.
-    const auto guard_result = core.data.guard(1, 2);
+    const auto guard_result = guard_data(core, 1, 2);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -321,7 +682,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -348,7 +709,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops and 2 pushes.
-    const auto guard_result = core.data.guard(2, 2);
+    const auto guard_result = guard_data(core, 2, 2);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -379,7 +740,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -389,7 +750,7 @@ class VM {
     // Get the value to push.
     const auto addr = core.data.pop();
     // Push the value to the addrs stack.
-    const auto push_result = core.addrs.push(addr);
+    const auto push_result = push_address(core, addr);
     const auto push_err = std::get<0>(push_result);
 
     if (push_err != ZError::None) {
@@ -413,7 +774,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 push.
-    const auto guard_result = core.data.guard(0, 1);
+    const auto guard_result = guard_data(core, 0, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -421,7 +782,7 @@ class VM {
     }
 
     // Get the addrs value to push.
-    const auto pop_result = core.addrs.pop();
+    const auto pop_result = pop_address(core);
     const auto pop_err = std::get<0>(pop_result);
     const auto addr = std::get<1>(pop_result);
     if (pop_err != ZError::None) {
@@ -450,7 +811,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops and 1 push.
-    const auto guard_result = core.data.guard(2, 1);
+    const auto guard_result = guard_data(core, 2, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -486,7 +847,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops and 1 push.
-    const auto guard_result = core.data.guard(2, 1);
+    const auto guard_result = guard_data(core, 2, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -523,7 +884,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops and 1 push.
-    const auto guard_result = core.data.guard(2, 1);
+    const auto guard_result = guard_data(core, 2, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -630,7 +991,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops and 2 pushes.
-    const auto guard_result = core.data.guard(2, 2);
+    const auto guard_result = guard_data(core, 2, 2);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -672,7 +1033,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops and 2 pushes.
-    const auto guard_result = core.data.guard(3, 2);
+    const auto guard_result = guard_data(core, 3, 2);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -744,7 +1105,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guards the stack for 1 pops and 1 pushes.
-    const auto guard_result = core.data.guard(1, 1);
+    const auto guard_result = guard_data(core, 1, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -796,7 +1157,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 4 pops and 1 push.
-    const auto guard_result = core.data.guard(4, 1);
+    const auto guard_result = guard_data(core, 4, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -830,7 +1191,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop and 4 pushes.
-    const auto guard_result = core.data.guard(1, 4);
+    const auto guard_result = guard_data(core, 1, 4);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -885,7 +1246,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -895,7 +1256,7 @@ class VM {
     // Calculate the return addrs
     const uint32_t return_addr = core.ip + 4;
     // Push the return addrs onto the stack.
-    const auto push_result = core.addrs.push(Cell{return_addr});
+    const auto push_result = push_address(core, Cell{return_addr});
     const auto push_err = std::get<0>(push_result);
 
     if (push_err != ZError::None) {
@@ -905,7 +1266,7 @@ class VM {
     // Pop the addrs of the subroutine to call.
     const auto call_addr = core.data.pop();
     // Calculate the new IP.
-    uint32_t ip;
+    uint32_t ip = 0;
     switch (core.addr_mode) {
       case AddressMode::DIRECT: {
         ip = call_addr.to_uint32();
@@ -917,7 +1278,8 @@ class VM {
         break;
       }
     }
-    // Set the IP.
+    // Record the edge and set the IP.
+    record_edge(core.ip, ip);
     core.ip = ip;
 
     // Set the addrs mode to `DIRECT`.
@@ -937,7 +1299,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops.
-    const auto guard_result = core.data.guard(2, 0);
+    const auto guard_result = guard_data(core, 2, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -953,7 +1315,7 @@ class VM {
       // Calculate the return addrs
       const uint32_t return_addr = core.ip + 4;
       // Push the return addrs onto the addrs stack.
-      const auto push_result = core.addrs.push(Cell{return_addr});
+      const auto push_result = push_address(core, Cell{return_addr});
       const auto push_err = std::get<0>(push_result);
 
       if (push_err != ZError::None) {
@@ -961,7 +1323,7 @@ class VM {
       }
 
       // Calculate the new IP.
-      uint32_t ip;
+      uint32_t ip = 0;
       switch (core.addr_mode) {
         case AddressMode::DIRECT: {
           ip = call_addr.to_uint32();
@@ -973,7 +1335,8 @@ class VM {
           break;
         }
       }
-      // Set the IP.
+      // Record the edge and set the IP.
+      record_edge(core.ip, ip);
       core.ip = ip;
     }
 
@@ -994,7 +1357,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1004,7 +1367,7 @@ class VM {
     // Get the addrs.
     const auto jump_addr = core.data.pop();
     // Calculate the new IP.
-    uint32_t ip;
+    uint32_t ip = 0;
     switch (core.addr_mode) {
       case AddressMode::DIRECT: {
         ip = jump_addr.to_uint32();
@@ -1016,7 +1379,8 @@ class VM {
         break;
       }
     }
-    // Set the IP.
+    // Record the edge and set the IP.
+    record_edge(core.ip, ip);
     core.ip = ip;
 
     // Set the addrs mode to `DIRECT`.
@@ -1036,7 +1400,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops.
-    const auto guard_result = core.data.guard(2, 0);
+    const auto guard_result = guard_data(core, 2, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1049,7 +1413,7 @@ class VM {
     const auto cond = core.data.pop();
     if (cond.to_bool()) {
       // Calculate the new IP.
-      uint32_t ip;
+      uint32_t ip = 0;
       switch (core.addr_mode) {
         case AddressMode::DIRECT: {
           ip = jump_addr.to_uint32();
@@ -1061,10 +1425,12 @@ class VM {
           break;
         }
       }
-      // Set the IP.
+      // Record the edge and set the IP.
+      record_edge(core.ip, ip);
       core.ip = ip;
     } else {
-      // If the condition is false, increment the IP.
+      // If the condition is false, record the edge and increment the IP.
+      record_edge(core.ip, core.ip + 4);
       core.ip += 4;
     }
 
@@ -1076,6 +1442,109 @@ class VM {
     return {ZError::None, Unit{}};
   }
 
+  /**
+   * Branches to the target in the following word of memory, like `JU`, `CJ`, `CA` and `CC` without popping it.
+   * The target is absolute in `DIRECT` mode and a signed offset from the instruction in `RELATIVE` mode.
+   * The instruction is 8 bytes long like `LW`, with the target at offset 4.
+   * @tparam Conditional Whether to pop a condition and only branch if it is true.
+   * @tparam Call Whether to push the return address like a call.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  template<bool Conditional, bool Call>
+  auto i_branch_immediate() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for the condition`s pop.
+    const auto guard_result = guard_data(core, Conditional ? 1 : 0, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Read the target from the core`s segment.
+    const auto read_result = mem->template read_bytes<4>(core.translate(core.ip + 4, 4));
+    const auto read_err = std::get<0>(read_result);
+    const auto target = std::get<1>(read_result);
+    if (read_err != ZError::None) {
+      return {read_err, Unit{}};
+    }
+
+    // Get the condition.
+    const auto taken = !Conditional || core.data.pop().to_bool();
+    if (taken) {
+      if (Call) {
+        // Push the return addrs onto the addrs stack.
+        const auto push_result = push_address(core, Cell{core.ip + 8});
+        const auto push_err = std::get<0>(push_result);
+
+        if (push_err != ZError::None) {
+          return {push_err, Unit{}};
+        }
+      }
+      // Calculate the new IP.
+      uint32_t ip = 0;
+      switch (core.addr_mode) {
+        case AddressMode::DIRECT: {
+          ip = target.to_uint32();
+          break;
+        }
+
+        case AddressMode::RELATIVE: {
+          ip = core.ip + static_cast<uint32_t>(target.to_int32());
+          break;
+        }
+      }
+      // Record the edge and set the IP.
+      record_edge(core.ip, ip);
+      core.ip = ip;
+    } else {
+      // If the condition is false, record the edge and skip the target.
+      record_edge(core.ip, core.ip + 8);
+      core.ip += 8;
+    }
+
+    // Set the addrs mode to `DIRECT`.
+    core.addr_mode = AddressMode::DIRECT;
+    // Set the operation mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Jumps to the target in the following word of memory.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_jump_immediate() noexcept -> std::pair<ZError, Unit> {
+    return i_branch_immediate<false, false>();
+  }
+
+  /**
+   * Jumps to the target in the following word of memory if the popped condition is true.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_conditional_jump_immediate() noexcept -> std::pair<ZError, Unit> {
+    return i_branch_immediate<true, false>();
+  }
+
+  /**
+   * Calls the subroutine at the target in the following word of memory.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_call_immediate() noexcept -> std::pair<ZError, Unit> {
+    return i_branch_immediate<false, true>();
+  }
+
+  /**
+   * Calls the subroutine at the target in the following word of memory if the popped condition is true.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_conditional_call_immediate() noexcept -> std::pair<ZError, Unit> {
+    return i_branch_immediate<true, true>();
+  }
+
   /**
    * Returns from a subroutine. Pops the `ip` from the addrs stack.
    * @return Unit if the operation was successful. ZError otherwise.
@@ -1085,13 +1554,14 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Pop the return addrs.
-    const auto pop_result = core.addrs.pop();
+    const auto pop_result = pop_address(core);
     const auto pop_err = std::get<0>(pop_result);
     const auto ret_addr = std::get<1>(pop_result);
     if (pop_err != ZError::None) {
       return {pop_err, Unit{}};
     }
-    // Set the IP.
+    // Record the edge and set the IP.
+    record_edge(core.ip, ret_addr.to_uint32());
     core.ip = ret_addr.to_uint32();
 
     // Set the addrs mode to `DIRECT`.
@@ -1112,7 +1582,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1124,16 +1594,18 @@ class VM {
     // If the condition is true, push the current IP onto the addrs stack.
     if (cond.to_bool()) {
       // Pop the return addrs.
-      const auto pop_result = core.addrs.pop();
+      const auto pop_result = pop_address(core);
       const auto pop_err = std::get<0>(pop_result);
       const auto ret_addr = std::get<1>(pop_result);
       if (pop_err != ZError::None) {
         return {pop_err, Unit{}};
       }
-      // Set the IP.
+      // Record the edge and set the IP.
+      record_edge(core.ip, ret_addr.to_uint32());
       core.ip = ret_addr.to_uint32();
     } else {
-      // If the condition is false, increment the IP.
+      // If the condition is false, record the edge and increment the IP.
+      record_edge(core.ip, core.ip + 4);
       core.ip += 4;
     }
 
@@ -1154,7 +1626,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops.
-    const auto guard_result = core.data.guard(2, 0);
+    const auto guard_result = guard_data(core, 2, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1226,7 +1698,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1237,7 +1709,25 @@ class VM {
     auto int_id = core.data.pop();
     // Force interrupt if interrupts are enabled.
     if (int_enabled) {
+      // Check the arrival against the replay log, or log it.
+      if (replay_source != nullptr) {
+        const auto replay_err = std::get<0>(replay_next(ReplayEventKind::Interrupt, int_id.to_uint32()));
+        if (replay_err != ZError::None) {
+          return {replay_err, Unit{}};
+        }
+      } else if (replay_recorder != nullptr) {
+        replay_recorder->record(ReplayEventKind::Interrupt, replay_stamp(), int_id.to_uint32());
+      }
+      interrupts_delivered += 1;
+      if (timeline != nullptr) {
+        timeline->record(cycle_now(), cur_core_id, TimelineEventKind::InterruptEnter, int_id.to_uint32());
+      }
       interrupt(int_id.to_uint32());
+      if (timeline != nullptr) {
+        timeline->record(cycle_now(), cur_core_id, TimelineEventKind::InterruptExit, int_id.to_uint32());
+      }
+    } else {
+      interrupts_masked += 1;
     }
 
     // Increment the ip.
@@ -1258,7 +1748,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1268,7 +1758,31 @@ class VM {
     // Get the current I/O id
     auto io_id = core.data.pop().to_size();
     // Call the I/O
-    io_table.call(io_id);
+    io_calls += 1;
+    io_errors += io_id >= IO_TABLE_SIZE;
+    if (timeline != nullptr) {
+      timeline->record(cycle_now(), cur_core_id, TimelineEventKind::IoEnter, static_cast<uint32_t>(io_id));
+    }
+    if (io_queue != nullptr) {
+      // Queue the request for the host instead of calling the callback.
+      auto payload = std::get<1>(mem->read_block(io_payload_addr, io_payload_len));
+      io_queue->push(IoRequest{static_cast<uint32_t>(io_id), static_cast<uint32_t>(cur_core_id), std::move(payload)});
+    } else if (replay_source != nullptr) {
+      // Replay what the callback did instead of calling it.
+      const auto replay_err = std::get<0>(replay_io_call(static_cast<uint32_t>(io_id)));
+      if (replay_err != ZError::None) {
+        return {replay_err, Unit{}};
+      }
+    } else if (replay_recorder != nullptr) {
+      replay_recorder->record(ReplayEventKind::IoCall, replay_stamp(), static_cast<uint32_t>(io_id));
+      io_table.call(io_id);
+      replay_recorder->record(ReplayEventKind::IoReturn, replay_stamp(), static_cast<uint32_t>(io_id));
+    } else {
+      io_table.call(io_id);
+    }
+    if (timeline != nullptr) {
+      timeline->record(cycle_now(), cur_core_id, TimelineEventKind::IoExit, static_cast<uint32_t>(io_id));
+    }
 
     // Increment the ip.
     core.ip += 1;
@@ -1301,7 +1815,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops.
-    const auto guard_result = core.data.guard(2, 0);
+    const auto guard_result = guard_data(core, 2, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1312,8 +1826,13 @@ class VM {
     auto core_id = core.data.pop();
     // Get the ip addrs.
     auto addr = core.data.pop();
+    if (core_id.to_uint32() >= CORE_COUNT) {
+      return {ZError::IllegalCoreId, Unit{}};
+    }
     // Initialize the core.
-    cores[core_id.to_uint32()].init(addr.to_uint32());
+    auto &core_to_init = cores[core_id.to_uint32()];
+    core_to_init.set_active(false, cycle_now());
+    core_to_init.init(addr.to_uint32());
 
     // Increment the ip.
     core.ip += 1;
@@ -1332,7 +1851,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 pops.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1341,10 +1860,16 @@ class VM {
 
     // Get the core id.
     auto core_id = core.data.pop();
+    if (core_id.to_uint32() >= CORE_COUNT) {
+      return {ZError::IllegalCoreId, Unit{}};
+    }
     // Get the core to activate.
     auto &core_to_activate = cores[core_id.to_uint32()];
     // Activate the core.
-    core_to_activate.active = true;
+    core_to_activate.set_active(true, cycle_now());
+    if (timeline != nullptr) {
+      timeline->record(cycle_now(), cur_core_id, TimelineEventKind::CoreActivated, core_id.to_uint32());
+    }
 
     // Increment the ip.
     core.ip += 1;
@@ -1363,7 +1888,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 pops.
-    const auto guard_result = core.data.guard(1, 0);
+    const auto guard_result = guard_data(core, 1, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1372,10 +1897,16 @@ class VM {
 
     // Get the core id.
     auto core_id = core.data.pop();
+    if (core_id.to_uint32() >= CORE_COUNT) {
+      return {ZError::IllegalCoreId, Unit{}};
+    }
     // Get the core to pause.
     auto &core_to_pause = cores[core_id.to_uint32()];
     // Pause the core.
-    core_to_pause.active = false;
+    core_to_pause.set_active(false, cycle_now());
+    if (timeline != nullptr) {
+      timeline->record(cycle_now(), cur_core_id, TimelineEventKind::CorePaused, core_id.to_uint32());
+    }
 
     // Increment the ip.
     core.ip += 1;
@@ -1394,7 +1925,10 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Pause the core.
-    core.active = false;
+    core.set_active(false, cycle_now());
+    if (timeline != nullptr) {
+      timeline->record(cycle_now(), cur_core_id, TimelineEventKind::CoreSuspended, cur_core_id);
+    }
 
     // Increment the ip.
     core.ip += 1;
@@ -1413,7 +1947,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 1 stack_pop and 1 push.
-    const auto guard_result = core.data.guard(1, 1);
+    const auto guard_result = guard_data(core, 1, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1450,7 +1984,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 2 pops.
-    const auto guard_result = core.data.guard(2, 0);
+    const auto guard_result = guard_data(core, 2, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1486,7 +2020,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 3 pops.
-    const auto guard_result = core.data.guard(3, 0);
+    const auto guard_result = guard_data(core, 3, 0);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1499,8 +2033,9 @@ class VM {
     auto dst = core.data.pop();
     // Get the origin addrs.
     auto orig = core.data.pop();
-    // Copy the block.
-    const auto cpy_result = mem.copy_block(len.to_uint32(), dst.to_uint32(), orig.to_uint32());
+    // Copy the block within the core`s segment.
+    const auto cpy_result = mem->copy_block(len.to_uint32(), core.translate(dst.to_uint32(), len.to_uint32()),
+                                           core.translate(orig.to_uint32(), len.to_uint32()));
     const auto cpy_err = std::get<0>(cpy_result);
 
     if (cpy_err != ZError::None) {
@@ -1512,6 +2047,11 @@ class VM {
     // Set op mode to `SIGNED`.
     core.op_mode = OpMode::SIGNED;
 
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
     return {ZError::None, Unit{}};
   }
 
@@ -1524,7 +2064,7 @@ class VM {
     auto &core = cores[cur_core_id];
 
     // Guard the stack for 3 pops and 1 push.
-    const auto guard_result = core.data.guard(3, 1);
+    const auto guard_result = guard_data(core, 3, 1);
     const auto guard_err = std::get<0>(guard_result);
 
     if (guard_err != ZError::None) {
@@ -1537,8 +2077,9 @@ class VM {
     auto dst = core.data.pop();
     // Get the origin addrs.
     auto orig = core.data.pop();
-    // Get the outcome.
-    const auto cmp_result = mem.compare_block(len.to_uint32(), dst.to_uint32(), orig.to_uint32());
+    // Get the outcome, within the core`s segment.
+    const auto cmp_result = mem->compare_block(len.to_uint32(), core.translate(dst.to_uint32(), len.to_uint32()),
+                                              core.translate(orig.to_uint32(), len.to_uint32()));
     const auto cmp_err = std::get<0>(cmp_result);
     const auto result = std::get<1>(cmp_result);
     if (cmp_err != ZError::None) {
@@ -1588,69 +2129,1053 @@ class VM {
     return {ZError::None, Unit{}};
   }
 
-  auto interrupt(size_t int_id) noexcept -> void {
-    // TODO: implement
-  }
-
   /**
-   * Interprets the current instruction in memory.
-   * @return
+   * Pushes the low 32 bits of a performance counter, selected by first pop, to the stack.
+   * See `PerfCounterId` for the counters. Differences of two reads are correct modulo 2^32.
+   * @return Unit if the operation was successful. ZError otherwise.
    */
-  auto interpret() noexcept -> std::pair<ZError, Unit> {
-    // Construct a jump table. indexes are opcodes and values are the handler blocks.
-    static const void *table[] = {
-        &&l_no, &&l_lw, &&l_lh, &&l_lb,
-        &&l_fw, &&l_fh, &&l_fb, &&l_sw,
-        &&l_sh, &&l_sb, &&l_du, &&l_dr,
-        &&l_sp, &&l_pu, &&l_po, &&l_eq,
-        &&l_ne, &&l_lt, &&l_gt, &&l_ad,
-        &&l_su, &&l_mu, &&l_dm, &&l_md,
-        &&l_an, &&l_or, &&l_xo, &&l_nt,
-        &&l_sl, &&l_sr, &&l_pa, &&l_un,
-        &&l_rl, &&l_ca, &&l_cc, &&l_ju,
-        &&l_cj, &&l_re, &&l_cr, &&l_sv,
-        &&l_hi, &&l_si, &&l_ti, &&l_ii,
-        &&l_hs, &&l_ic, &&l_ac, &&l_pc,
-        &&l_sc, &&l_rr, &&l_wr, &&l_cp,
-        &&l_bc, &&l_uu, &&l_ff
-    };
+  auto i_perf_counter() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
 
-    // Set current core id as the last core so a call to sel_next_core()
-    // in fetch block will select core 0
-    cur_core_id = CORE_COUNT - 1;
+    // Guard the stack for 1 pop and 1 push.
+    const auto guard_result = guard_data(core, 1, 1);
+    const auto guard_err = std::get<0>(guard_result);
 
-    goto fetch;
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
 
-    fetch:
-    {
-      // Select the next core
-      sel_next_core();
-      // Get current core`s instruction pointer.
-      const auto ip = cores[cur_core_id].ip;
-      // Fetch the op code.
-      const auto fetch_result = mem.fetch_opcode(ip);
-      const auto fetch_err = std::get<0>(fetch_result);
-      const auto op_code = std::get<1>(fetch_result);
-      // If System Halt error is return, interpreting is over, return.
-      if (fetch_err != ZError::None) {
-        return {fetch_err, Unit{}};
+    // Get the counter id.
+    const auto counter_id = core.data.pop().to_uint32();
+    // Read the counter.
+    uint64_t value;
+    switch (counter_id) {
+      case static_cast<uint32_t>(PerfCounterId::RETIRED): {
+        value = core.retired;
+        break;
+      }
+      case static_cast<uint32_t>(PerfCounterId::CYCLES): {
+        value = cycle_now();
+        break;
+      }
+      case static_cast<uint32_t>(PerfCounterId::NANOSECONDS): {
+        value = monotonic_ns();
+        break;
+      }
+      default: {
+        return {ZError::IllegalCounterId, Unit{}};
       }
-
-      // Jump to the corresponding instruction.
-      goto
-      *table[op_code];
     }
+    // Take the value from the replay log, or log it.
+    if (replay_source != nullptr) {
+      const auto replay_result = replay_next(ReplayEventKind::Counter, 0);
+      const auto replay_err = std::get<0>(replay_result);
+      if (replay_err != ZError::None) {
+        return {replay_err, Unit{}};
+      }
+      value = std::get<1>(replay_result).arg;
+    } else if (replay_recorder != nullptr) {
+      replay_recorder->record(ReplayEventKind::Counter, replay_stamp(), static_cast<uint32_t>(value));
+    }
+    // Push the counter`s low 32 bits.
+    core.data.push(Cell{static_cast<uint32_t>(value)});
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Traps at a breakpoint. Breakpoints patch `BK` over the original instructions, which memory keeps aside,
+   * so fetches don`t check for breakpoints.
+   * @return The original opcode to execute if the breakpoint is being stepped over, `Breakpoint` otherwise.
+   */
+  auto i_breakpoint() noexcept -> std::pair<ZError, uint8_t> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Find the breakpoint, a `BK` in the program itself always traps.
+    const auto ip = core.ip;
+    const auto addr = core.seg_base + ip;
+    if (mem->has_breakpoint(addr) && resuming && resume_core == cur_core_id && resume_ip == ip) {
+      // Execute the original instruction.
+      resuming = false;
+      return {ZError::None, static_cast<uint8_t>(std::get<1>(mem->read_bytes<1>(addr)).to_uint32())};
+    }
+
+    // The instruction wasn`t executed.
+    core.retired -= 1;
+    return {ZError::Breakpoint, uint8_t{}};
+  }
+
+  /**
+   * Sets up the guest heap over #2 pop bytes of memory at #3 pop, in arena mode if #1 pop isn`t 0.
+   * Everything allocated before is released. The region is relative to the core`s segment.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_heap_init() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 3 pops.
+    const auto guard_result = guard_data(core, 3, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the mode.
+    const auto arena = core.data.pop().to_uint32() != 0;
+    // Get the size.
+    const auto size = core.data.pop().to_uint32();
+    // Get the region`s beginning within the core`s segment.
+    const auto begin = core.translate(core.data.pop().to_uint32(), size);
+    if (begin >= MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    heap.init(begin, size, arena);
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Allocates #1 pop bytes on the guest heap and pushes the block`s address.
+   * @return Unit if the operation was successful. `OutOfMemory` if the heap is exhausted,
+   * `IllegalMemoryAddress` if the heap isn`t in the core`s segment, ZError otherwise.
+   */
+  auto i_allocate() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 1 pop and 1 push.
+    const auto guard_result = guard_data(core, 1, 1);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Only use the heap if it is in the core`s segment.
+    if (!heap_in_segment(core)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+
+    // Get the size.
+    const auto size = core.data.pop().to_uint32();
+    // Allocate the block.
+    const auto alloc_result = heap.allocate(*mem, size);
+    const auto alloc_err = std::get<0>(alloc_result);
+
+    if (alloc_err != ZError::None) {
+      return {alloc_err, Unit{}};
+    }
+
+    // Push the block`s address relative to the core`s segment.
+    core.data.push(Cell{std::get<1>(alloc_result) - core.seg_base});
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Frees the guest heap block at #1 pop.
+   * @return Unit if the operation was successful. `IllegalMemoryAddress` if the block isn`t allocated
+   * or the heap isn`t in the core`s segment, ZError otherwise.
+   */
+  auto i_free() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 1 pop.
+    const auto guard_result = guard_data(core, 1, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Only use the heap if it is in the core`s segment.
+    if (!heap_in_segment(core)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+
+    // Get the block`s address within the core`s segment.
+    const auto addr = core.translate(core.data.pop().to_uint32(), 1);
+    // Free the block.
+    const auto free_result = heap.free(*mem, addr);
+    const auto free_err = std::get<0>(free_result);
+
+    if (free_err != ZError::None) {
+      return {free_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Releases everything allocated on the guest heap at once.
+   * @return Unit, or `IllegalMemoryAddress` if the heap isn`t in the core`s segment.
+   */
+  auto i_arena_reset() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Only use the heap if it is in the core`s segment.
+    if (!heap_in_segment(core)) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+
+    heap.reset();
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Sorts #1 pop words of memory at #2 pop in place, in the order of the operation mode.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_sort() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 2 pops.
+    const auto guard_result = guard_data(core, 2, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the length.
+    const auto len = core.data.pop().to_uint32();
+    // Get the array`s address.
+    const auto addr = core.data.pop().to_uint32();
+    // Sort the array within the core`s segment.
+    const auto sort_result = mem->sort_words(core.translate(addr, static_cast<size_t>(len) * 4), len, core.op_mode);
+    const auto sort_err = std::get<0>(sort_result);
+
+    if (sort_err != ZError::None) {
+      return {sort_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Binary searches #2 pop words of memory at #3 pop, sorted in the order of the operation mode, for #1 pop,
+   * and pushes the index to insert it at.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_binary_search() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 3 pops and 1 push.
+    const auto guard_result = guard_data(core, 3, 1);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the word to search for.
+    const auto word = core.data.pop().to_uint32();
+    // Get the length.
+    const auto len = core.data.pop().to_uint32();
+    // Get the array`s address.
+    const auto addr = core.data.pop().to_uint32();
+    // Search the array within the core`s segment.
+    const auto search_result = mem->search_words(core.translate(addr, static_cast<size_t>(len) * 4), len, word,
+                                                 core.op_mode);
+    const auto search_err = std::get<0>(search_result);
+
+    if (search_err != ZError::None) {
+      return {search_err, Unit{}};
+    }
+
+    // Push the index.
+    core.data.push(Cell{std::get<1>(search_result)});
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Creates an empty hash table of #1 pop slots at memory address #2 pop.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_hash_init() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 2 pops.
+    const auto guard_result = guard_data(core, 2, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the capacity.
+    const auto capacity = core.data.pop().to_uint32();
+    // Get the table`s address within the core`s segment.
+    const auto addr = core.translate(core.data.pop().to_uint32(), HASH_TABLE_HEADER_SIZE);
+    // Create the table.
+    const auto init_result = HashTable::init(*mem, addr, capacity, core.seg_base + core.seg_limit);
+    const auto init_err = std::get<0>(init_result);
+
+    if (init_err != ZError::None) {
+      return {init_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Looks up key #1 pop in the hash table at memory address #2 pop, and pushes its value (0 if not found)
+   * and whether it was found.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_hash_lookup() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 2 pops and 2 pushes.
+    const auto guard_result = guard_data(core, 2, 2);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the key.
+    const auto key = core.data.pop().to_uint32();
+    // Get the table`s address within the core`s segment.
+    const auto addr = core.translate(core.data.pop().to_uint32(), HASH_TABLE_HEADER_SIZE);
+    // Look up the key.
+    const auto lookup_result = HashTable::lookup(*mem, addr, key, core.seg_base + core.seg_limit);
+    const auto lookup_err = std::get<0>(lookup_result);
+
+    if (lookup_err != ZError::None) {
+      return {lookup_err, Unit{}};
+    }
+
+    // Push the value and whether it was found.
+    const auto lookup = std::get<1>(lookup_result);
+    core.data.push(Cell{lookup.value});
+    core.data.push(Cell{lookup.found});
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Inserts key #2 pop with value #1 pop into the hash table at memory address #3 pop,
+   * replacing the key`s value if it is already there.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_hash_insert() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 3 pops.
+    const auto guard_result = guard_data(core, 3, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the value.
+    const auto value = core.data.pop().to_uint32();
+    // Get the key.
+    const auto key = core.data.pop().to_uint32();
+    // Get the table`s address within the core`s segment.
+    const auto addr = core.translate(core.data.pop().to_uint32(), HASH_TABLE_HEADER_SIZE);
+    // Insert the key.
+    const auto insert_result = HashTable::insert(*mem, addr, key, value, core.seg_base + core.seg_limit);
+    const auto insert_err = std::get<0>(insert_result);
+
+    if (insert_err != ZError::None) {
+      return {insert_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Deletes key #1 pop from the hash table at memory address #2 pop, and pushes whether it was found.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_hash_delete() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 2 pops and 1 push.
+    const auto guard_result = guard_data(core, 2, 1);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the key.
+    const auto key = core.data.pop().to_uint32();
+    // Get the table`s address within the core`s segment.
+    const auto addr = core.translate(core.data.pop().to_uint32(), HASH_TABLE_HEADER_SIZE);
+    // Delete the key.
+    const auto remove_result = HashTable::remove(*mem, addr, key, core.seg_base + core.seg_limit);
+    const auto remove_err = std::get<0>(remove_result);
+
+    if (remove_err != ZError::None) {
+      return {remove_err, Unit{}};
+    }
+
+    // Push whether the key was found.
+    core.data.push(Cell{std::get<1>(remove_result)});
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Pushes the dot product of the #1 pop words of memory at #3 pop and #2 pop, in the operation mode.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_dot_product() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 3 pops and 1 push.
+    const auto guard_result = guard_data(core, 3, 1);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the length.
+    const auto len = core.data.pop().to_uint32();
+    // Get the arrays` addresses within the core`s segment.
+    const auto b = translate_words(core, core.data.pop().to_uint32(), len);
+    const auto a = translate_words(core, core.data.pop().to_uint32(), len);
+    // Compute the dot product.
+    const auto dot_result = mem->dot_words(a, b, len, core.op_mode);
+    const auto dot_err = std::get<0>(dot_result);
+
+    if (dot_err != ZError::None) {
+      return {dot_err, Unit{}};
+    }
+
+    // Push the dot product.
+    core.data.push(Cell{std::get<1>(dot_result)});
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Runs the FIR filter of #2 pop taps at memory address #3 pop over the window of #1 pop + #2 pop - 1 words
+   * at #4 pop, writing #1 pop filtered words to #5 pop, in the operation mode.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_fir_filter() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 5 pops.
+    const auto guard_result = guard_data(core, 5, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the lengths.
+    const auto len = core.data.pop().to_uint32();
+    const auto tap_count = core.data.pop().to_uint32();
+    // Get the arrays` addresses within the core`s segment.
+    const auto taps = translate_words(core, core.data.pop().to_uint32(), tap_count);
+    // The window holds `tap_count - 1` words more than the output.
+    const auto in = translate_words(core, core.data.pop().to_uint32(), static_cast<uint64_t>(len) + tap_count - 1);
+    const auto out = translate_words(core, core.data.pop().to_uint32(), len);
+    // Filter the window.
+    const auto filter_result = mem->filter_words(out, in, taps, tap_count, len, core.op_mode);
+    const auto filter_err = std::get<0>(filter_result);
+
+    if (filter_err != ZError::None) {
+      return {filter_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Multiplies the #3 pop by #2 pop row major matrix at memory address #5 pop by the #2 pop by #1 pop one at
+   * #4 pop, writing the product to #6 pop, in the operation mode.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_matrix_multiply() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 6 pops.
+    const auto guard_result = guard_data(core, 6, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the dimensions.
+    const auto cols = core.data.pop().to_uint32();
+    const auto inner = core.data.pop().to_uint32();
+    const auto rows = core.data.pop().to_uint32();
+    // Get the matrices` addresses within the core`s segment.
+    const auto b = translate_words(core, core.data.pop().to_uint32(), static_cast<uint64_t>(inner) * cols);
+    const auto a = translate_words(core, core.data.pop().to_uint32(), static_cast<uint64_t>(rows) * inner);
+    const auto c = translate_words(core, core.data.pop().to_uint32(), static_cast<uint64_t>(rows) * cols);
+    // Multiply the matrices.
+    const auto multiply_result = mem->multiply_matrices(c, a, b, rows, inner, cols, core.op_mode);
+    const auto multiply_err = std::get<0>(multiply_result);
+
+    if (multiply_err != ZError::None) {
+      return {multiply_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Transforms #2 pop complex floats at memory address #3 pop in place by an FFT, or by its inverse if #1 pop is
+   * true. The complex floats are interleaved (real, imaginary) float words whatever the operation mode.
+   * @return Unit if the operation was successful. ZError otherwise.
+   */
+  auto i_fourier_transform() noexcept -> std::pair<ZError, Unit> {
+    // Get the current core.
+    auto &core = cores[cur_core_id];
+
+    // Guard the stack for 3 pops.
+    const auto guard_result = guard_data(core, 3, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      return {guard_err, Unit{}};
+    }
+
+    // Get the direction.
+    const auto inverse = core.data.pop().to_bool();
+    // Get the number of complex floats.
+    const auto points = core.data.pop().to_uint32();
+    // Get the array`s address within the core`s segment.
+    const auto addr = translate_words(core, core.data.pop().to_uint32(), static_cast<uint64_t>(points) * 2);
+    // Transform the array.
+    const auto transform_result = mem->fourier_transform(addr, points, inverse, twiddles);
+    const auto transform_err = std::get<0>(transform_result);
+
+    if (transform_err != ZError::None) {
+      return {transform_err, Unit{}};
+    }
+
+    // Increment the ip.
+    core.ip += 1;
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    // Stop after the write if it hit a watchpoint.
+    if (mem->take_watch_hit()) {
+      return {ZError::Watchpoint, Unit{}};
+    }
+
+    return {ZError::None, Unit{}};
+  }
+
+  auto interrupt(size_t int_id) noexcept -> void {
+    // TODO: implement
+  }
+
+#ifdef ZAGROS_TAIL_CALL_DISPATCH
+  /// An instruction handler of the tail call backend. The current core, the memory and the core`s instruction pointer
+  /// are passed along in argument registers, `core.ip` is only up to date while a generic handler runs and once the
+  /// chain returns.
+  typedef std::pair<ZError, Unit> (*TailHandler)(VM &vm, Core &core, Memory &mem, uint32_t ip);
+
+  /**
+   * Gets the handlers of the tail call backend. Indexes are opcodes.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @return The handlers.
+   */
+  template<bool Budgeted>
+  static auto tail_table() noexcept -> const TailHandler * {
+    static const TailHandler table[] = {
+        &VM::tail_nop<Budgeted>, &VM::tail_load<Budgeted, 4, 4, 8>,
+        &VM::tail_load<Budgeted, 2, 1, 3>, &VM::tail_load<Budgeted, 1, 1, 2>,
+        &VM::tail_handler<Budgeted, &VM::i_fetch_word>, &VM::tail_handler<Budgeted, &VM::i_fetch_half>,
+        &VM::tail_handler<Budgeted, &VM::i_fetch_byte>, &VM::tail_handler<Budgeted, &VM::i_store_word>,
+        &VM::tail_handler<Budgeted, &VM::i_store_half>, &VM::tail_handler<Budgeted, &VM::i_store_byte>,
+        &VM::tail_handler<Budgeted, &VM::i_dupe>, &VM::tail_handler<Budgeted, &VM::i_drop>,
+        &VM::tail_handler<Budgeted, &VM::i_swap>, &VM::tail_handler<Budgeted, &VM::i_push_address>,
+        &VM::tail_handler<Budgeted, &VM::i_pop_address>, &VM::tail_handler<Budgeted, &VM::i_equal>,
+        &VM::tail_handler<Budgeted, &VM::i_not_equal>, &VM::tail_handler<Budgeted, &VM::i_less_than>,
+        &VM::tail_handler<Budgeted, &VM::i_greater_than>, &VM::tail_handler<Budgeted, &VM::i_add>,
+        &VM::tail_handler<Budgeted, &VM::i_subtract>, &VM::tail_handler<Budgeted, &VM::i_multiply>,
+        &VM::tail_handler<Budgeted, &VM::i_divide_remainder>,
+        &VM::tail_handler<Budgeted, &VM::i_multiply_divide_remainder>,
+        &VM::tail_handler<Budgeted, &VM::i_and>, &VM::tail_handler<Budgeted, &VM::i_or>,
+        &VM::tail_handler<Budgeted, &VM::i_xor>, &VM::tail_handler<Budgeted, &VM::i_not>,
+        &VM::tail_handler<Budgeted, &VM::i_shift_left>, &VM::tail_handler<Budgeted, &VM::i_shift_right>,
+        &VM::tail_handler<Budgeted, &VM::i_pack_bytes>, &VM::tail_handler<Budgeted, &VM::i_unpack_bytes>,
+        &VM::tail_handler<Budgeted, &VM::i_relative>, &VM::tail_handler<Budgeted, &VM::i_call>,
+        &VM::tail_handler<Budgeted, &VM::i_conditional_call>, &VM::tail_handler<Budgeted, &VM::i_jump>,
+        &VM::tail_handler<Budgeted, &VM::i_conditional_jump>, &VM::tail_handler<Budgeted, &VM::i_return>,
+        &VM::tail_handler<Budgeted, &VM::i_conditional_return>, &VM::tail_handler<Budgeted, &VM::i_set_interrupt>,
+        &VM::tail_handler<Budgeted, &VM::i_halt_interrupts>, &VM::tail_handler<Budgeted, &VM::i_start_interrupts>,
+        &VM::tail_handler<Budgeted, &VM::i_trigger_interrupt>, &VM::tail_handler<Budgeted, &VM::i_invoke_io>,
+        &VM::tail_handler<Budgeted, &VM::i_halt_system>, &VM::tail_handler<Budgeted, &VM::i_init_core>,
+        &VM::tail_handler<Budgeted, &VM::i_activate_core>, &VM::tail_handler<Budgeted, &VM::i_pause_core>,
+        &VM::tail_handler<Budgeted, &VM::i_suspend_cur_core>, &VM::tail_handler<Budgeted, &VM::i_read_register>,
+        &VM::tail_handler<Budgeted, &VM::i_write_register>, &VM::tail_handler<Budgeted, &VM::i_copy_block>,
+        &VM::tail_handler<Budgeted, &VM::i_block_compare>, &VM::tail_handler<Budgeted, &VM::i_unsigned_mode>,
+        &VM::tail_handler<Budgeted, &VM::i_float_mode>, &VM::tail_handler<Budgeted, &VM::i_perf_counter>,
+        &VM::tail_breakpoint<Budgeted>, &VM::tail_handler<Budgeted, &VM::i_heap_init>,
+        &VM::tail_handler<Budgeted, &VM::i_allocate>, &VM::tail_handler<Budgeted, &VM::i_free>,
+        &VM::tail_handler<Budgeted, &VM::i_arena_reset>, &VM::tail_branch_immediate<Budgeted, false, false>,
+        &VM::tail_branch_immediate<Budgeted, true, false>, &VM::tail_branch_immediate<Budgeted, false, true>,
+        &VM::tail_branch_immediate<Budgeted, true, true>, &VM::tail_handler<Budgeted, &VM::i_sort>,
+        &VM::tail_handler<Budgeted, &VM::i_binary_search>, &VM::tail_handler<Budgeted, &VM::i_hash_init>,
+        &VM::tail_handler<Budgeted, &VM::i_hash_lookup>, &VM::tail_handler<Budgeted, &VM::i_hash_insert>,
+        &VM::tail_handler<Budgeted, &VM::i_hash_delete>, &VM::tail_handler<Budgeted, &VM::i_dot_product>,
+        &VM::tail_handler<Budgeted, &VM::i_fir_filter>, &VM::tail_handler<Budgeted, &VM::i_matrix_multiply>,
+        &VM::tail_handler<Budgeted, &VM::i_fourier_transform>
+    };
+    return table;
+  }
+
+  /**
+   * Fetches the next instruction of the next core and tail calls its handler.
+   * Keep in sync with the fetch block of `interpret`.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @tparam Select Whether to select the next core, or run the current one.
+   * @param vm The vm.
+   * @param core The core that executed the last instruction.
+   * @param mem The vm`s memory.
+   * @param ip The core`s instruction pointer.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted, bool Select = true>
+  static auto tail_fetch(VM &vm, Core &core, Memory &mem, uint32_t ip) -> std::pair<ZError, Unit> {
+    // Stop if the instruction budget is spent, before selecting the next core so the next run selects it.
+    if (Budgeted) {
+      if (vm.budget == 0) {
+        core.ip = ip;
+        return {ZError::InstructionLimitReached, Unit{}};
+      }
+      vm.budget -= 1;
+    }
+    // Select the next core
+    if (Select) {
+      vm.sel_next_core();
+    }
+    // Swap the instruction pointer in the argument registers if the core changed.
+    auto &next = vm.cores[vm.cur_core_id];
+    if (&next != &core) {
+      core.ip = ip;
+      ip = next.ip;
+    }
+    // Fetch the op code from the core`s segment.
+    const auto fetch_result = mem.fetch_opcode(next.translate(ip, 1));
+    const auto fetch_err = std::get<0>(fetch_result);
+    const auto op_code = std::get<1>(fetch_result);
+    // If System Halt error is return, interpreting is over, return.
+    if (fetch_err != ZError::None) {
+      next.ip = ip;
+      return {fetch_err, Unit{}};
+    }
+    // Record the instruction in the core`s execution trace.
+    if (vm.trace_enabled) {
+      next.trace.record(ip, op_code, next.data);
+    }
+    next.retired += 1;
+
+    // Call the corresponding handler.
+    ZAGROS_MUSTTAIL return tail_table<Budgeted>()[op_code](vm, next, mem, ip);
+  }
+
+  /**
+   * Executes an instruction and tail calls the fetch of the next one.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @tparam Handler The instruction.
+   * @param vm The vm.
+   * @param core The current core.
+   * @param mem The vm`s memory.
+   * @param ip The core`s instruction pointer.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted, std::pair<ZError, Unit> (VM::*Handler)()>
+  static auto tail_handler(VM &vm, Core &core, Memory &mem, uint32_t ip) -> std::pair<ZError, Unit> {
+    // Generic handlers work on the core, so hand them the instruction pointer and take it back.
+    core.ip = ip;
+    const auto err_result = (vm.*Handler)();
+    const auto err = std::get<0>(err_result);
+
+    if (err != ZError::None) {
+      return {err, Unit{}};
+    }
+
+    ZAGROS_MUSTTAIL return tail_fetch<Budgeted>(vm, core, mem, core.ip);
+  }
+
+  /**
+   * Traps at a breakpoint, or tail calls the original instruction`s handler if it is being stepped over.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @param vm The vm.
+   * @param core The current core.
+   * @param mem The vm`s memory.
+   * @param ip The core`s instruction pointer.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted>
+  static auto tail_breakpoint(VM &vm, Core &core, Memory &mem, uint32_t ip) -> std::pair<ZError, Unit> {
+    core.ip = ip;
+    const auto err_result = vm.i_breakpoint();
+    const auto err = std::get<0>(err_result);
+
+    if (err != ZError::None) {
+      return {err, Unit{}};
+    }
+
+    // Execute the original instruction.
+    ZAGROS_MUSTTAIL return tail_table<Budgeted>()[std::get<1>(err_result)](vm, core, mem, core.ip);
+  }
+
+  /**
+   * `NO`, keeping the instruction pointer in its register. Keep in sync with `i_nop`.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @param vm The vm.
+   * @param core The current core.
+   * @param mem The vm`s memory.
+   * @param ip The core`s instruction pointer.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted>
+  static auto tail_nop(VM &vm, Core &core, Memory &mem, uint32_t ip) -> std::pair<ZError, Unit> {
+    // Set op mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    ZAGROS_MUSTTAIL return tail_fetch<Budgeted>(vm, core, mem, ip + 1);
+  }
+
+  /**
+   * `LW`, `LH` and `LB`, keeping the instruction pointer in its register. Keep in sync with `i_load`.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @tparam S The size of the value in bytes.
+   * @tparam Offset The offset of the value from the instruction.
+   * @tparam Len The length of the instruction.
+   * @param vm The vm.
+   * @param core The current core.
+   * @param mem The vm`s memory.
+   * @param ip The core`s instruction pointer.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted, size_t S, size_t Offset, size_t Len>
+  static auto tail_load(VM &vm, Core &core, Memory &mem, uint32_t ip) -> std::pair<ZError, Unit> {
+    // Guard the stack for 1 push.
+    const auto guard_result = vm.guard_data(core, 0, 1);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      core.ip = ip;
+      return {guard_err, Unit{}};
+    }
+
+    // Read the value from the core`s segment.
+    const auto read_result = mem.template read_bytes<S>(core.translate(ip + Offset, S));
+    const auto read_err = std::get<0>(read_result);
+    if (read_err != ZError::None) {
+      core.ip = ip;
+      return {read_err, Unit{}};
+    }
+
+    // Push the value to the stack.
+    core.data.push(std::get<1>(read_result));
+    // Set the operation mode to 'SIGNED'
+    core.op_mode = OpMode::SIGNED;
+
+    ZAGROS_MUSTTAIL return tail_fetch<Budgeted>(vm, core, mem, static_cast<uint32_t>(ip + Len));
+  }
+
+  /**
+   * `JI`, `JT`, `CI` and `CT`, keeping the instruction pointer in its register. Keep in sync with
+   * `i_branch_immediate`.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @tparam Conditional Whether to pop a condition and only branch if it is true.
+   * @tparam Call Whether to push the return address like a call.
+   * @param vm The vm.
+   * @param core The current core.
+   * @param mem The vm`s memory.
+   * @param ip The core`s instruction pointer.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted, bool Conditional, bool Call>
+  static auto tail_branch_immediate(VM &vm, Core &core, Memory &mem, uint32_t ip) -> std::pair<ZError, Unit> {
+    // Guard the stack for the condition`s pop.
+    const auto guard_result = vm.guard_data(core, Conditional ? 1 : 0, 0);
+    const auto guard_err = std::get<0>(guard_result);
+
+    if (guard_err != ZError::None) {
+      core.ip = ip;
+      return {guard_err, Unit{}};
+    }
+
+    // Read the target from the core`s segment.
+    const auto read_result = mem.template read_bytes<4>(core.translate(ip + 4, 4));
+    const auto read_err = std::get<0>(read_result);
+    const auto target = std::get<1>(read_result);
+    if (read_err != ZError::None) {
+      core.ip = ip;
+      return {read_err, Unit{}};
+    }
+
+    // Get the condition.
+    const auto taken = !Conditional || core.data.pop().to_bool();
+    uint32_t next_ip = ip + 8;
+    if (taken) {
+      if (Call) {
+        // Push the return addrs onto the addrs stack.
+        const auto push_result = vm.push_address(core, Cell{ip + 8});
+        const auto push_err = std::get<0>(push_result);
+
+        if (push_err != ZError::None) {
+          core.ip = ip;
+          return {push_err, Unit{}};
+        }
+      }
+      // Calculate the new IP.
+      switch (core.addr_mode) {
+        case AddressMode::DIRECT: {
+          next_ip = target.to_uint32();
+          break;
+        }
+
+        case AddressMode::RELATIVE: {
+          next_ip = ip + static_cast<uint32_t>(target.to_int32());
+          break;
+        }
+      }
+    }
+    // Record the edge.
+    vm.record_edge(ip, next_ip);
+
+    // Set the addrs mode to `DIRECT`.
+    core.addr_mode = AddressMode::DIRECT;
+    // Set the operation mode to `SIGNED`.
+    core.op_mode = OpMode::SIGNED;
+
+    ZAGROS_MUSTTAIL return tail_fetch<Budgeted>(vm, core, mem, next_ip);
+  }
+#endif
+
+  /**
+   * Interprets the current instruction in memory.
+   * Plain runs use the unbudgeted variant, so their dispatch doesn`t count down a budget.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @return
+   */
+  template<bool Budgeted>
+  auto interpret() noexcept -> std::pair<ZError, Unit> {
+#ifdef ZAGROS_TAIL_CALL_DISPATCH
+    // Each handler is its own function and tail calls the next one, see `tail_fetch`.
+    // Continue the round robin if the last run spent its budget, start it over at the first active core otherwise.
+    if (budget_spent) {
+      auto &core = cores[cur_core_id];
+      return tail_fetch<Budgeted>(*this, core, *mem, core.ip);
+    }
+    sel_first_core();
+    auto &core = cores[cur_core_id];
+    return tail_fetch<Budgeted, false>(*this, core, *mem, core.ip);
+#else
+    // Construct a jump table. indexes are opcodes and values are the handler blocks.
+    static const void *table[] = {
+        &&l_no, &&l_lw, &&l_lh, &&l_lb,
+        &&l_fw, &&l_fh, &&l_fb, &&l_sw,
+        &&l_sh, &&l_sb, &&l_du, &&l_dr,
+        &&l_sp, &&l_pu, &&l_po, &&l_eq,
+        &&l_ne, &&l_lt, &&l_gt, &&l_ad,
+        &&l_su, &&l_mu, &&l_dm, &&l_md,
+        &&l_an, &&l_or, &&l_xo, &&l_nt,
+        &&l_sl, &&l_sr, &&l_pa, &&l_un,
+        &&l_rl, &&l_ca, &&l_cc, &&l_ju,
+        &&l_cj, &&l_re, &&l_cr, &&l_sv,
+        &&l_hi, &&l_si, &&l_ti, &&l_ii,
+        &&l_hs, &&l_ic, &&l_ac, &&l_pc,
+        &&l_sc, &&l_rr, &&l_wr, &&l_cp,
+        &&l_bc, &&l_uu, &&l_ff, &&l_pf,
+        &&l_bk, &&l_hp, &&l_al, &&l_fr,
+        &&l_ar, &&l_ji, &&l_jt, &&l_ci,
+        &&l_ct, &&l_so, &&l_bs, &&l_hn,
+        &&l_hl, &&l_ha, &&l_hd, &&l_dp,
+        &&l_fi, &&l_mm, &&l_ft
+    };
+
+    // Fetches the next instruction of the next core and jumps to its handler.
+    // With `ZAGROS_REPLICATED_DISPATCH` every handler ends with its own copy instead of jumping back to `fetch`,
+    // so the branch predictor tracks each handler`s indirect jump with its own history.
+#define ZAGROS_FETCH_AND_DISPATCH(SELECT)                                 \
+    {                                                                     \
+      /* Stop if the instruction budget is spent, before selecting the */ \
+      /* next core so the next run selects it. */                         \
+      if (Budgeted) {                                                     \
+        if (budget == 0) {                                                \
+          return {ZError::InstructionLimitReached, Unit{}};               \
+        }                                                                 \
+        budget -= 1;                                                      \
+      }                                                                   \
+      /* Select the next core */                                          \
+      if (SELECT) {                                                       \
+        sel_next_core();                                                  \
+      }                                                                   \
+      /* Get current core`s instruction pointer. */                       \
+      auto &core = cores[cur_core_id];                                    \
+      const auto ip = core.ip;                                            \
+      /* Fetch the op code from the core`s segment. */                    \
+      const auto fetch_result = mem->fetch_opcode(core.translate(ip, 1)); \
+      const auto fetch_err = std::get<0>(fetch_result);                   \
+      const auto op_code = std::get<1>(fetch_result);                     \
+      /* If System Halt error is return, interpreting is over, return. */ \
+      if (fetch_err != ZError::None) {                                    \
+        return {fetch_err, Unit{}};                                       \
+      }                                                                   \
+      /* Record the instruction in the core`s execution trace. */         \
+      if (trace_enabled) {                                                \
+        core.trace.record(ip, op_code, core.data);                        \
+      }                                                                   \
+      core.retired += 1;                                                  \
+      /* Jump to the corresponding instruction. */                        \
+      goto                                                                \
+      *table[op_code];                                                    \
+    }
+
+#ifdef ZAGROS_REPLICATED_DISPATCH
+#define ZAGROS_DISPATCH() ZAGROS_FETCH_AND_DISPATCH(true)
+#else
+#define ZAGROS_DISPATCH() goto fetch
+#endif
+
+    // Continue the round robin if the last run spent its budget, start it over at the first active core otherwise.
+    if (budget_spent) {
+      goto fetch;
+    }
+    sel_first_core();
+    ZAGROS_FETCH_AND_DISPATCH(false);
+
+    fetch:
+    ZAGROS_FETCH_AND_DISPATCH(true);
+
+    l_no:
+    {
+      const auto err_result = i_nop();
+      const auto err = std::get<0>(err_result);
 
-    l_no:
-    {
-      const auto err_result = i_nop();
-      const auto err = std::get<0>(err_result);
-
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_lw:
     {
@@ -1661,7 +3186,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_lh:
     {
@@ -1672,7 +3197,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_lb:
     {
@@ -1683,7 +3208,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_fw:
     {
@@ -1694,7 +3219,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_fh:
     {
@@ -1705,7 +3230,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_fb:
     {
@@ -1716,7 +3241,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_sw:
     {
@@ -1727,7 +3252,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_sh:
     {
@@ -1738,7 +3263,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_sb:
     {
@@ -1749,7 +3274,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_du:
     {
@@ -1760,7 +3285,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_dr:
     {
@@ -1771,7 +3296,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_sp:
     {
@@ -1782,7 +3307,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_pu:
     {
@@ -1793,7 +3318,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_po:
     {
@@ -1804,7 +3329,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_eq:
     {
@@ -1815,7 +3340,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_ne:
     {
@@ -1826,7 +3351,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_lt:
     {
@@ -1837,7 +3362,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_gt:
     {
@@ -1848,7 +3373,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_ad:
     {
@@ -1859,7 +3384,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_su:
     {
@@ -1870,7 +3395,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_mu:
     {
@@ -1881,7 +3406,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_dm:
     {
@@ -1892,7 +3417,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_md:
     {
@@ -1903,7 +3428,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_an:
     {
@@ -1914,7 +3439,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_or:
     {
@@ -1925,7 +3450,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_xo:
     {
@@ -1936,7 +3461,7 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_nt:
     {
@@ -1947,306 +3472,572 @@ class VM {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
     l_sl:
     {
-      const auto err_result = i_shift_left();
+      const auto err_result = i_shift_left();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_sr:
+    {
+      const auto err_result = i_shift_right();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_pa:
+    {
+      const auto err_result = i_pack_bytes();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_un:
+    {
+      const auto err_result = i_unpack_bytes();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_rl:
+    {
+      const auto err_result = i_relative();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_ca:
+    {
+      const auto err_result = i_call();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_cc:
+    {
+      const auto err_result = i_conditional_call();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_ju:
+    {
+      const auto err_result = i_jump();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_cj:
+    {
+      const auto err_result = i_conditional_jump();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_re:
+    {
+      const auto err_result = i_return();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_cr:
+    {
+      const auto err_result = i_conditional_return();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_sv:
+    {
+      const auto err_result = i_set_interrupt();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_hi:
+    {
+      const auto err_result = i_halt_interrupts();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_si:
+    {
+      const auto err_result = i_start_interrupts();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_ti:
+    {
+      const auto err_result = i_trigger_interrupt();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_ii:
+    {
+      const auto err_result = i_invoke_io();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_hs:
+    {
+      const auto err_result = i_halt_system();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_ic:
+    {
+      const auto err_result = i_init_core();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_ac:
+    {
+      const auto err_result = i_activate_core();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_pc:
+    {
+      const auto err_result = i_pause_core();
+      const auto err = std::get<0>(err_result);
+
+      if (err != ZError::None) {
+        return {err, Unit{}};
+      }
+
+      ZAGROS_DISPATCH();
+    }
+    l_sc:
+    {
+      const auto err_result = i_suspend_cur_core();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_sr:
+    l_rr:
     {
-      const auto err_result = i_shift_right();
+      const auto err_result = i_read_register();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_pa:
+    l_wr:
     {
-      const auto err_result = i_pack_bytes();
+      const auto err_result = i_write_register();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_un:
+    l_cp:
     {
-      const auto err_result = i_unpack_bytes();
+      const auto err_result = i_copy_block();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_rl:
+    l_bc:
     {
-      const auto err_result = i_relative();
+      const auto err_result = i_block_compare();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ca:
+    l_uu:
     {
-      const auto err_result = i_call();
+      const auto err_result = i_unsigned_mode();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_cc:
+    l_ff:
     {
-      const auto err_result = i_conditional_call();
+      const auto err_result = i_float_mode();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ju:
+    l_pf:
     {
-      const auto err_result = i_jump();
+      const auto err_result = i_perf_counter();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_cj:
+    l_bk:
     {
-      const auto err_result = i_conditional_jump();
+      const auto err_result = i_breakpoint();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      // Execute the original instruction.
+      goto
+      *table[std::get<1>(err_result)];
     }
-    l_re:
+    l_hp:
     {
-      const auto err_result = i_return();
+      const auto err_result = i_heap_init();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_cr:
+    l_al:
     {
-      const auto err_result = i_conditional_return();
+      const auto err_result = i_allocate();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_sv:
+    l_fr:
     {
-      const auto err_result = i_set_interrupt();
+      const auto err_result = i_free();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_hi:
+    l_ar:
     {
-      const auto err_result = i_halt_interrupts();
+      const auto err_result = i_arena_reset();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_si:
+    l_ji:
     {
-      const auto err_result = i_start_interrupts();
+      const auto err_result = i_jump_immediate();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ti:
+    l_jt:
     {
-      const auto err_result = i_trigger_interrupt();
+      const auto err_result = i_conditional_jump_immediate();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ii:
+    l_ci:
     {
-      const auto err_result = i_invoke_io();
+      const auto err_result = i_call_immediate();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_hs:
+    l_ct:
     {
-      const auto err_result = i_halt_system();
+      const auto err_result = i_conditional_call_immediate();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ic:
+    l_so:
     {
-      const auto err_result = i_init_core();
+      const auto err_result = i_sort();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ac:
+    l_bs:
     {
-      const auto err_result = i_activate_core();
+      const auto err_result = i_binary_search();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_pc:
+    l_hn:
     {
-      const auto err_result = i_pause_core();
+      const auto err_result = i_hash_init();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_sc:
+    l_hl:
     {
-      const auto err_result = i_suspend_cur_core();
+      const auto err_result = i_hash_lookup();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_rr:
+    l_ha:
     {
-      const auto err_result = i_read_register();
+      const auto err_result = i_hash_insert();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_wr:
+    l_hd:
     {
-      const auto err_result = i_write_register();
+      const auto err_result = i_hash_delete();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_cp:
+    l_dp:
     {
-      const auto err_result = i_copy_block();
+      const auto err_result = i_dot_product();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_bc:
+    l_fi:
     {
-      const auto err_result = i_block_compare();
+      const auto err_result = i_fir_filter();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_uu:
+    l_mm:
     {
-      const auto err_result = i_unsigned_mode();
+      const auto err_result = i_matrix_multiply();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
     }
-    l_ff:
+    l_ft:
     {
-      const auto err_result = i_float_mode();
+      const auto err_result = i_fourier_transform();
       const auto err = std::get<0>(err_result);
 
       if (err != ZError::None) {
         return {err, Unit{}};
       }
 
-      goto fetch;
+      ZAGROS_DISPATCH();
+    }
+
+#undef ZAGROS_DISPATCH
+#undef ZAGROS_FETCH_AND_DISPATCH
+#endif
+  }
+
+  /**
+   * Interprets until the vm stops, accounting the run but not its stop.
+   * @tparam Budgeted Whether to stop once the instruction budget is spent.
+   * @return The error that stopped the vm.
+   */
+  template<bool Budgeted>
+  auto execute() noexcept -> std::pair<ZError, Unit> {
+    // Patch the breakpoints the host lifted by accessing memory directly.
+    mem->patch_breakpoints();
+    if (replay_source != nullptr) {
+      replay_writes();
     }
+    if (host_counters != nullptr) {
+      host_counters->start();
+    }
+    const auto begin = cycle_now();
+    const auto result = interpret<Budgeted>();
+    const auto end = cycle_now();
+    run_cycles += end - begin;
+    if (timeline != nullptr) {
+      timeline->record(end, cur_core_id, TimelineEventKind::CoreDescheduled);
+    }
+    if (host_counters != nullptr) {
+      host_counter_values = host_counters->stop();
+    }
+    budget_spent = std::get<0>(result) == ZError::InstructionLimitReached;
+    return result;
+  }
 
+  /**
+   * Counts the error that stopped the vm.
+   * If execution tracing is enabled and the vm stopped on an error, the traces are dumped.
+   * @param err The error.
+   */
+  auto count_stop(ZError err) noexcept -> void {
+    stops[static_cast<size_t>(err)] += 1;
+    if (trace_enabled && err != ZError::SystemHalt && err != ZError::InstructionLimitReached) {
+      trace_dump = dump_trace();
+    }
   }
 
  public:
@@ -2256,8 +4047,10 @@ class VM {
    */
   VM()
   noexcept {
+    const auto now = cycle_now();
     for (auto &core : cores) {
       core = Core{};
+      core.parked_since = now;
     }
     cores[0].active = true;
   }
@@ -2266,19 +4059,46 @@ class VM {
    * Constructs the vm with a valid io table
    * @param io_table The IO table
    */
-  explicit VM(IoTable io_table) : io_table{io_table} {
+  explicit VM(IoTable io_table) : io_table{std::move(io_table)} {
+    const auto now = cycle_now();
     for (auto &core : cores) {
       core = Core{};
+      core.parked_since = now;
     }
     cores[0].active = true;
   }
 
+  /**
+   * Creates a vm with a program loaded at address 0. The vm is constructed in place in the result,
+   * and moving it doesn`t copy its memory.
+   * @param prg The program.
+   * @param prg_size The size of the program.
+   * @param io_table The IO table.
+   * @return The vm, with `IllegalMemoryAddress` if the program doesn`t fit into memory.
+   */
+  static auto create(const uint8_t *prg, size_t prg_size, IoTable io_table = IoTable{}) -> std::pair<ZError, VM> {
+    std::pair<ZError, VM> result;
+    result.second.io_table = std::move(io_table);
+    result.first = std::get<0>(result.second.load_program(prg, prg_size));
+    return result;
+  }
+
+  /**
+   * Loads a program at address 0 without copying a whole memory array.
+   * @param prg The program.
+   * @param prg_size The size of the program.
+   * @return `IllegalMemoryAddress` if the program doesn`t fit into memory, Unit otherwise.
+   */
+  auto load_program(const uint8_t *prg, size_t prg_size) noexcept -> std::pair<ZError, Unit> {
+    return mem->load_program(prg, prg_size);
+  }
+
   /**
    * Loads the memory from a memory array.
    * @param is The input stream.
    */
   auto load_program(std::array<uint8_t, MEMORY_SIZE> prg, size_t prg_size) noexcept -> void {
-    mem.load_program(prg, prg_size);
+    mem->load_program(prg, prg_size);
   }
 
   /**
@@ -2288,15 +4108,399 @@ class VM {
    * @return Result of the operation
    */
   std::pair<ZError, Unit> io_write(size_t addr, uint8_t byte) noexcept {
-    return mem.write_io_byte(addr, byte);
+    const auto result = mem->write_io_byte(addr, byte);
+    io_errors += std::get<0>(result) != ZError::None;
+    if (replay_recorder != nullptr && std::get<0>(result) == ZError::None) {
+      replay_recorder->record(ReplayEventKind::IoWrite, replay_stamp(), static_cast<uint32_t>(addr), byte);
+    }
+    return result;
   }
 
   std::pair<ZError, uint8_t> io_read(size_t addr) noexcept {
-    return mem.read_io_byte(addr);
+    const auto result = mem->read_io_byte(addr);
+    io_errors += std::get<0>(result) != ZError::None;
+    if (replay_recorder != nullptr && std::get<0>(result) == ZError::None) {
+      replay_recorder->record(ReplayEventKind::IoRead, replay_stamp(), static_cast<uint32_t>(addr),
+                              std::get<1>(result));
+    }
+    return result;
+  }
+
+  /**
+   * Runs the vm until it halts or an error occurs.
+   * If execution tracing is enabled and the vm stopped on an error, the traces are dumped.
+   * @return The error that stopped the vm.
+   */
+  auto run() noexcept -> std::pair<ZError, Unit> {
+    const auto result = execute<false>();
+    count_stop(std::get<0>(result));
+    return result;
+  }
+
+  /**
+   * Runs the vm until it halts, an error occurs or it executed a number of instructions.
+   * @param instructions The instruction budget.
+   * @return The error that stopped the vm, `InstructionLimitReached` if the budget is spent.
+   */
+  auto run_for(uint64_t instructions) noexcept -> std::pair<ZError, Unit> {
+    budget = instructions;
+    const auto result = execute<true>();
+    count_stop(std::get<0>(result));
+    return result;
+  }
+
+  /**
+   * Executes a single instruction of the next core in the round robin.
+   * A step that executed its instruction isn`t counted as a stop.
+   * @return Unit if the instruction was executed, the error that stopped the vm otherwise.
+   */
+  auto step() noexcept -> std::pair<ZError, Unit> {
+    budget = 1;
+    const auto result = execute<true>();
+    const auto err = std::get<0>(result);
+    if (err == ZError::InstructionLimitReached) {
+      return {ZError::None, Unit{}};
+    }
+    count_stop(err);
+    return result;
+  }
+
+  /**
+   * Writes a block of bytes into memory. While recording a replay log, every byte is recorded.
+   * @param addr The address of the block.
+   * @param bytes The bytes.
+   * @param len The number of bytes.
+   * @return Result of the operation
+   */
+  auto write_memory(size_t addr, const uint8_t *bytes, size_t len) noexcept -> std::pair<ZError, Unit> {
+    const auto result = mem->write_block(addr, bytes, len);
+    if (replay_recorder != nullptr && std::get<0>(result) == ZError::None) {
+      const auto stamp = replay_stamp();
+      for (size_t i = 0; i < len; ++i) {
+        replay_recorder->record(ReplayEventKind::MemoryWrite, stamp, static_cast<uint32_t>(addr + i), bytes[i]);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Copies a block of bytes out of memory.
+   * @param addr The address of the block.
+   * @param out The buffer to copy into.
+   * @param len The number of bytes.
+   * @return Result of the operation
+   */
+  auto read_memory(size_t addr, uint8_t *out, size_t len) const noexcept -> std::pair<ZError, Unit> {
+    return mem->read_block(addr, out, len);
+  }
+
+  /**
+   * Gets the guest memory for direct access by the host, e.g. the zero-copy memoryview of the Python bindings.
+   * Direct writes can`t be recorded, so there is no access while recording a replay log, use `write_memory` instead.
+   * @return The first of `MEMORY_SIZE` bytes, valid as long as the vm. `nullptr` while recording a replay log.
+   */
+  auto memory_data() noexcept -> uint8_t * {
+    if (replay_recorder != nullptr) {
+      return nullptr;
+    }
+    return mem->data();
+  }
+
+  /**
+   * Resets the vm to the state of another vm, copying back only the memory pages written to since.
+   * This vm must be a copy of `base`, or restored from it before. The I/O table and metrics are kept.
+   * @param base The vm to restore from.
+   */
+  auto restore(const VM &base) noexcept -> void {
+    mem->restore_dirty(*base.mem);
+    int_table = base.int_table;
+    cores = base.cores;
+    cur_core_id = base.cur_core_id;
+    budget_spent = base.budget_spent;
+    int_enabled = base.int_enabled;
+    heap = base.heap;
+  }
+
+  /**
+   * Sets the callback of an I/O id. The vm doesn`t take ownership of the callback.
+   * @param io_id The I/O id.
+   * @param callback The callback, must outlive the vm or be replaced first. `nullptr` to call nothing.
+   * @return `IllegalMemoryAddress` if the I/O id is invalid, Unit otherwise.
+   */
+  auto set_io_callback(size_t io_id, Callback *callback) noexcept -> std::pair<ZError, Unit> {
+    return io_table.set(io_id, callback);
+  }
+
+  /**
+   * Queues I/O requests for the host to drain in batches instead of calling the callbacks.
+   * The queue must outlive the vm, or be unset with `nullptr` first.
+   * @param queue The queue, `nullptr` to call the callbacks again.
+   * @param payload_addr The address of the I/O memory copied into each request.
+   * @param payload_len The number of I/O memory bytes copied into each request.
+   * @return `IllegalMemoryAddress` if the payload isn`t in I/O memory, Unit otherwise.
+   */
+  auto set_io_queue(IoRequestQueue *queue, size_t payload_addr = 0, size_t payload_len = 0) noexcept
+  -> std::pair<ZError, Unit> {
+    if (payload_addr < IO_MEMORY_ADDRESS_BEGIN || payload_addr + payload_len > IO_MEMORY_ADDRESS_END) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    io_queue = queue;
+    io_payload_addr = payload_addr;
+    io_payload_len = payload_len;
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Records I/O calls, host accesses to I/O memory, host writes with `write_memory`, interrupt arrivals and
+   * performance counter reads into a log. `memory_data` gives no direct access while recording.
+   * The log must outlive the vm, or be unset with `nullptr` first.
+   * @param log The log, `nullptr` to stop recording.
+   */
+  auto record_replay(ReplayLog *log) noexcept -> void {
+    replay_recorder = log;
+  }
+
+  /**
+   * Replays a recorded log: I/O callbacks aren`t called, the host writes to I/O memory and the performance counter
+   * values are taken from the log instead. The vm stops with `ReplayDivergence` if it doesn`t follow the log.
+   * The log must outlive the vm, or be unset with `nullptr` first.
+   * @param log The log, `nullptr` to stop replaying.
+   */
+  auto replay(ReplayLog *log) noexcept -> void {
+    replay_source = log;
+  }
+
+  /**
+   * Sets the memory segment of a core. Every address the core uses, including its ip, is relative to the segment,
+   * and accesses outside of it fail with `IllegalMemoryAddress`, so tenants sharing the memory are isolated.
+   * Switching a core between tenants only swaps its segment and state, not memory.
+   * @param core_id The core.
+   * @param base The first memory address of the segment.
+   * @param limit The size of the segment.
+   * @return `IllegalMemoryAddress` if the segment isn`t in memory, Unit otherwise.
+   */
+  auto set_segment(size_t core_id, uint32_t base, uint32_t limit) noexcept -> std::pair<ZError, Unit> {
+    if (core_id >= CORE_COUNT || static_cast<size_t>(base) + limit > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    cores[core_id].seg_base = base;
+    cores[core_id].seg_limit = limit;
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Lets a core`s stacks spill into memory instead of failing with `DataStackOverflow` or `AddressStackOverflow`.
+   * The top of each stack stays in the core, when a stack is full its bottom cells are moved into the region
+   * in blocks of `STACK_SPILL_BLOCK` and moved back when the core runs out of cells. Snapshots show only the top.
+   * The regions are memory regions, not relative to the core`s segment, and must not be used for anything else.
+   * Anything spilled before is dropped.
+   * @param core_id The core.
+   * @param data_addr The first memory address of the data stack`s region.
+   * @param data_cells The number of cells the data stack can spill, 0 to disable spilling.
+   * @param addrs_addr The first memory address of the address stack`s region.
+   * @param addrs_cells The number of cells the address stack can spill, 0 to disable spilling.
+   * @return `IllegalMemoryAddress` if the core doesn`t exist or a region isn`t in memory, Unit otherwise.
+   */
+  auto set_stack_spill(size_t core_id, uint32_t data_addr, uint32_t data_cells,
+                       uint32_t addrs_addr, uint32_t addrs_cells) noexcept -> std::pair<ZError, Unit> {
+    if (core_id >= CORE_COUNT || static_cast<size_t>(data_addr) + static_cast<size_t>(data_cells) * 4 > MEMORY_SIZE ||
+        static_cast<size_t>(addrs_addr) + static_cast<size_t>(addrs_cells) * 4 > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    auto &core = cores[core_id];
+    core.data_spill_base = data_addr;
+    core.data_spill_cells = data_cells;
+    core.data_spilled = 0;
+    core.addrs_spill_base = addrs_addr;
+    core.addrs_spill_cells = addrs_cells;
+    core.addrs_spilled = 0;
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Sets up the guest heap used by `AL`, `FR` and `AR`, as `HP` does. Everything allocated before is released.
+   * The region is a memory region, not relative to a core`s segment.
+   * @param begin The first memory address of the region.
+   * @param size The size of the region.
+   * @param arena Whether to use arena mode: bump allocation, `FR` does nothing and `AR` releases everything.
+   * @return `IllegalMemoryAddress` if the region isn`t in memory, Unit otherwise.
+   */
+  auto set_heap(uint32_t begin, uint32_t size, bool arena) noexcept -> std::pair<ZError, Unit> {
+    if (static_cast<size_t>(begin) + size > MEMORY_SIZE) {
+      return {ZError::IllegalMemoryAddress, Unit{}};
+    }
+    heap.init(begin, size, arena);
+    return {ZError::None, Unit{}};
+  }
+
+  /**
+   * Gets the number of guest heap bytes between the beginning of the region and the highest block handed out.
+   * @return The number of bytes.
+   */
+  auto get_heap_used() const noexcept -> uint32_t {
+    return heap.get_used();
+  }
+
+  /**
+   * Sets a breakpoint on the instruction at an address. `BK` is patched over the instruction, but reads, copies and
+   * snapshots still see the instruction.
+   * The address is a memory address, not relative to a core`s segment.
+   * The vm stops with `Breakpoint` before executing the instruction, see `step_over_breakpoint` to continue.
+   * @param addr The address of the instruction.
+   * @return `IllegalMemoryAddress` if the address isn`t in memory, Unit otherwise.
+   */
+  auto set_breakpoint(uint32_t addr) -> std::pair<ZError, Unit> {
+    return mem->set_breakpoint(addr);
+  }
+
+  /**
+   * Clears a breakpoint.
+   * @param addr The address of the instruction.
+   * @return `IllegalMemoryAddress` if there is no breakpoint at the address, Unit otherwise.
+   */
+  auto clear_breakpoint(uint32_t addr) noexcept -> std::pair<ZError, Unit> {
+    return mem->clear_breakpoint(addr);
+  }
+
+  /**
+   * Makes the core that stopped at a breakpoint execute the original instruction when the vm runs again,
+   * instead of stopping at the same breakpoint. The breakpoint stays set.
+   */
+  auto step_over_breakpoint() noexcept -> void {
+    resuming = true;
+    resume_core = cur_core_id;
+    resume_ip = cores[cur_core_id].ip;
+  }
+
+  /**
+   * Watches a range of memory. The vm stops with `Watchpoint` after an instruction writes to it.
+   * Only stores to the pages of watched ranges are checked against the ranges.
+   * @param addr The address of the range.
+   * @param len The length of the range.
+   * @return `IllegalMemoryAddress` if the range isn`t in memory or is empty, Unit otherwise.
+   */
+  auto set_watchpoint(size_t addr, size_t len) -> std::pair<ZError, Unit> {
+    return mem->watch(addr, len);
+  }
+
+  /**
+   * Stops watching a range of memory.
+   * @param addr The address of the range, as given to `set_watchpoint`.
+   * @param len The length of the range, as given to `set_watchpoint`.
+   * @return `IllegalMemoryAddress` if the range wasn`t watched, Unit otherwise.
+   */
+  auto clear_watchpoint(size_t addr, size_t len) noexcept -> std::pair<ZError, Unit> {
+    return mem->unwatch(addr, len);
+  }
+
+  /**
+   * Gets the address of the write that last stopped the vm with `Watchpoint`.
+   * @return The address.
+   */
+  auto get_watchpoint_addr() const noexcept -> size_t {
+    return mem->get_watch_addr();
+  }
+
+  /**
+   * Sets the bitmap the branch instructions record edge coverage into.
+   * The bitmap must be `COVERAGE_MAP_SIZE` bytes and outlive the vm, or be unset with `nullptr` first.
+   * @param map The bitmap, e.g. AFL`s shared memory, `nullptr` to stop recording.
+   */
+  auto set_coverage_map(uint8_t *map) noexcept -> void {
+    coverage_map = map;
+  }
+
+  /**
+   * Sets the recorder of the scheduling timeline.
+   * The recorder must outlive the vm, or be unset with `nullptr` first.
+   * @param recorder The recorder, `nullptr` to stop recording.
+   */
+  auto set_timeline(TimelineRecorder *recorder) noexcept -> void {
+    timeline = recorder;
+  }
+
+  /**
+   * Enables or disables per I/O id call counts and latency histograms, see `IoTableSnapshot::get_stats`.
+   * @param enabled Whether or not to gather statistics.
+   */
+  auto enable_io_stats(bool enabled) -> void {
+    io_table.enable_stats(enabled);
+  }
+
+  /**
+   * Sets the host hardware counters to read around every `run`.
+   * The counters must be opened and must outlive the vm, or be unset with `nullptr` first.
+   * @param counters The counters, `nullptr` to stop counting.
+   */
+  auto set_host_counters(HostCounters *counters) noexcept -> void {
+    host_counters = counters;
+  }
+
+  /**
+   * Gets the host cycles and cache misses spent in the last `run`.
+   * @return The counts, zeros if no counters are set.
+   */
+  auto get_host_counter_values() const noexcept -> HostCounterValues {
+    return host_counter_values;
+  }
+
+  /**
+   * Enables or disables recording executed instructions in the cores` execution traces.
+   * @param enabled Whether or not to record.
+   */
+  auto enable_trace(bool enabled) noexcept -> void {
+    trace_enabled = enabled;
+  }
+
+  /**
+   * Dumps the execution traces of all cores in the binary trace format.
+   * Use `Disassembler::decode_trace` to turn the dump into text.
+   * @return The dump.
+   */
+  auto dump_trace() const -> std::vector<uint8_t> {
+    std::vector<uint8_t> out(TRACE_DUMP_MAGIC.begin(), TRACE_DUMP_MAGIC.end());
+    out.push_back(TRACE_DUMP_VERSION);
+    out.push_back(static_cast<uint8_t>(CORE_COUNT));
+    for (size_t i = 0; i < CORE_COUNT; ++i) {
+      cores[i].trace.dump(static_cast<uint8_t>(i), out);
+    }
+    return out;
+  }
+
+  /**
+   * Gets the execution traces dumped when the vm last stopped on an error.
+   * @return The dump, empty if the vm didn`t stop on an error with tracing enabled.
+   */
+  auto get_trace_dump() const noexcept -> const std::vector<uint8_t> & {
+    return trace_dump;
   }
 
-  auto run() noexcept -> void {
-    interpret();
+  /**
+   * Gets the vm`s metrics. Reading them doesn`t disturb a running vm`s hot path.
+   * @return The metrics.
+   */
+  auto metrics() const noexcept -> Metrics {
+    const auto now = cycle_now();
+    uint64_t retired = 0;
+    uint64_t parked = 0;
+    for (const auto &core : cores) {
+      retired += core.retired;
+      parked += core.parked_cycles;
+      if (!core.active) {
+        parked += now - core.parked_since;
+      }
+    }
+    return {retired, run_cycles, core_switches, parked, interrupts_delivered, interrupts_masked,
+            io_calls, io_errors, stops};
+  }
+
+  /**
+   * Gets a snapshot of a single core, without copying the memory.
+   * @param core_id The core, must be less than `CORE_COUNT`.
+   * @return A snapshot of the core
+   */
+  auto core_snapshot(size_t core_id) const noexcept -> CoreSnapshot {
+    return cores[core_id].snapshot();
   }
 
   /**
@@ -2309,7 +4513,7 @@ class VM {
       auto const snapshot = cores[i].snapshot();
       core_snapshots[i] = snapshot;
     }
-    return {mem.snapshot(), int_table.snapshot(), io_table.snapshot(), core_snapshots, cur_core_id, int_enabled};
+    return {mem->snapshot(), int_table.snapshot(), io_table.snapshot(), core_snapshots, cur_core_id, int_enabled};
   }
 };
 
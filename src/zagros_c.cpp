@@ -0,0 +1,216 @@
+#include <new>
+#include "zagros_c.h"
+#include "vm.hpp"
+
+static_assert(ZAGROS_DATA_STACK_SIZE == DATA_STACK_SIZE, "C API data stack size is out of date.");
+static_assert(ZAGROS_ADDRESS_STACK_SIZE == ADDRESS_STACK_SIZE, "C API address stack size is out of date.");
+static_assert(ZAGROS_REGISTER_BANK_SIZE == REGISTER_BANK_SIZE, "C API register bank size is out of date.");
+static_assert(ZAGROS_MEMORY_SIZE == MEMORY_SIZE, "C API memory size is out of date.");
+static_assert(ZAGROS_CORE_COUNT == CORE_COUNT, "C API core count is out of date.");
+static_assert(ZAGROS_IO_TABLE_SIZE == IO_TABLE_SIZE, "C API I/O table size is out of date.");
+
+/**
+ * Calls a C function pointer as an I/O callback.
+ */
+class FunctionCallback : public Callback {
+ public:
+  /// The VM handle passed to the function.
+  zagros_vm *vm = nullptr;
+
+  /// The I/O id passed to the function.
+  uint32_t io_id = 0;
+
+  /// The function.
+  zagros_io_fn fn = nullptr;
+
+  /// The user data passed to the function.
+  void *user_data = nullptr;
+
+  void run() override {
+    fn(vm, io_id, user_data);
+  }
+
+  std::string description() override {
+    return "C callback";
+  }
+};
+
+struct zagros_vm {
+  /// The VM.
+  VM vm;
+
+  /// The I/O callbacks, owned by the handle.
+  std::array<FunctionCallback, IO_TABLE_SIZE> callbacks;
+};
+
+/**
+ * Maps a `ZError` to its stable C value.
+ * @param err The error.
+ * @return The C value.
+ */
+static auto to_c_error(ZError err) noexcept -> zagros_error {
+  switch (err) {
+    case ZError::None: return ZAGROS_OK;
+    case ZError::DivisionByZero: return ZAGROS_DIVISION_BY_ZERO;
+    case ZError::InvalidFloatOperation: return ZAGROS_INVALID_FLOAT_OPERATION;
+    case ZError::OutOfMemory: return ZAGROS_OUT_OF_MEMORY;
+    case ZError::DataStackOverflow: return ZAGROS_DATA_STACK_OVERFLOW;
+    case ZError::DataStackUnderflow: return ZAGROS_DATA_STACK_UNDERFLOW;
+    case ZError::AddressStackOverflow: return ZAGROS_ADDRESS_STACK_OVERFLOW;
+    case ZError::AddressStackUnderflow: return ZAGROS_ADDRESS_STACK_UNDERFLOW;
+    case ZError::IllegalRegisterId: return ZAGROS_ILLEGAL_REGISTER_ID;
+    case ZError::IllegalMemoryAddress: return ZAGROS_ILLEGAL_MEMORY_ADDRESS;
+    case ZError::IllegalInterruptId: return ZAGROS_ILLEGAL_INTERRUPT_ID;
+    case ZError::IllegalCoreId: return ZAGROS_ILLEGAL_CORE_ID;
+    case ZError::IllegalCounterId: return ZAGROS_ILLEGAL_COUNTER_ID;
+    case ZError::InstructionLimitReached: return ZAGROS_INSTRUCTION_LIMIT_REACHED;
+    case ZError::ReplayDivergence: return ZAGROS_REPLAY_DIVERGENCE;
+    case ZError::Breakpoint: return ZAGROS_BREAKPOINT;
+    case ZError::Watchpoint: return ZAGROS_WATCHPOINT;
+    case ZError::IllegalOperand: return ZAGROS_ILLEGAL_OPERAND;
+    case ZError::SystemHalt: return ZAGROS_SYSTEM_HALT;
+  }
+  return ZAGROS_INVALID_ARGUMENT;
+}
+
+zagros_vm *zagros_create(void) {
+  auto handle = new(std::nothrow) zagros_vm{};
+  if (handle == nullptr) {
+    return nullptr;
+  }
+  // Start without callbacks instead of the default table`s placeholders.
+  for (size_t i = 0; i < IO_TABLE_SIZE; ++i) {
+    handle->vm.set_io_callback(i, nullptr);
+  }
+  return handle;
+}
+
+void zagros_destroy(zagros_vm *vm) {
+  delete vm;
+}
+
+zagros_error zagros_load(zagros_vm *vm, const uint8_t *program, size_t len) {
+  if (vm == nullptr || (program == nullptr && len > 0)) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.write_memory(0, program, len)));
+}
+
+zagros_error zagros_run(zagros_vm *vm) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.run()));
+}
+
+zagros_error zagros_run_for(zagros_vm *vm, uint64_t instructions) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.run_for(instructions)));
+}
+
+zagros_error zagros_step(zagros_vm *vm) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.step()));
+}
+
+uint8_t *zagros_memory(zagros_vm *vm) {
+  if (vm == nullptr) {
+    return nullptr;
+  }
+  return vm->vm.memory_data();
+}
+
+zagros_error zagros_read_memory(zagros_vm *vm, size_t addr, uint8_t *out, size_t len) {
+  if (vm == nullptr || (out == nullptr && len > 0)) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.read_memory(addr, out, len)));
+}
+
+zagros_error zagros_write_memory(zagros_vm *vm, size_t addr, const uint8_t *bytes, size_t len) {
+  if (vm == nullptr || (bytes == nullptr && len > 0)) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.write_memory(addr, bytes, len)));
+}
+
+zagros_error zagros_set_io_callback(zagros_vm *vm, uint32_t io_id, zagros_io_fn fn, void *user_data) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  if (io_id >= IO_TABLE_SIZE) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  auto &callback = vm->callbacks[io_id];
+  callback.vm = vm;
+  callback.io_id = io_id;
+  callback.fn = fn;
+  callback.user_data = user_data;
+  return to_c_error(std::get<0>(vm->vm.set_io_callback(io_id, fn == nullptr ? nullptr : &callback)));
+}
+
+zagros_error zagros_get_core_state(zagros_vm *vm, uint32_t core_id, zagros_core_state *out) {
+  if (vm == nullptr || out == nullptr || core_id >= CORE_COUNT) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  const auto core = vm->vm.core_snapshot(core_id);
+  out->ip = core.get_ip();
+  out->active = core.is_active() ? 1 : 0;
+  out->op_mode = static_cast<uint8_t>(core.get_op_mode());
+  out->addr_mode = static_cast<uint8_t>(core.get_addr_mode());
+  const auto data = core.get_data().get_arr();
+  out->data_depth = static_cast<uint32_t>(core.get_data().get_top());
+  for (size_t i = 0; i < DATA_STACK_SIZE; ++i) {
+    out->data[i] = data[i].to_int32();
+  }
+  const auto addrs = core.get_addrs().get_arr();
+  out->addr_depth = static_cast<uint32_t>(core.get_addrs().get_top());
+  for (size_t i = 0; i < ADDRESS_STACK_SIZE; ++i) {
+    out->addrs[i] = addrs[i].to_uint32();
+  }
+  const auto regs = core.get_regs().get_arr();
+  for (size_t i = 0; i < REGISTER_BANK_SIZE; ++i) {
+    out->regs[i] = regs[i].to_int32();
+  }
+  return ZAGROS_OK;
+}
+
+zagros_error zagros_set_breakpoint(zagros_vm *vm, uint32_t addr) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.set_breakpoint(addr)));
+}
+
+zagros_error zagros_clear_breakpoint(zagros_vm *vm, uint32_t addr) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.clear_breakpoint(addr)));
+}
+
+zagros_error zagros_step_over_breakpoint(zagros_vm *vm) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  vm->vm.step_over_breakpoint();
+  return ZAGROS_OK;
+}
+
+zagros_error zagros_set_watchpoint(zagros_vm *vm, size_t addr, size_t len) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.set_watchpoint(addr, len)));
+}
+
+zagros_error zagros_clear_watchpoint(zagros_vm *vm, size_t addr, size_t len) {
+  if (vm == nullptr) {
+    return ZAGROS_INVALID_ARGUMENT;
+  }
+  return to_c_error(std::get<0>(vm->vm.clear_watchpoint(addr, len)));
+}
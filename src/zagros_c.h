@@ -0,0 +1,240 @@
+#ifndef ZAGROS_C
+#define ZAGROS_C
+
+/*
+ * A stable C ABI for embedding the Zagros VM in hosts other than C++, e.g. C, Rust or Go.
+ * VMs are opaque handles. Nothing is returned through C++ types, memory is read and written by pointer and length,
+ * and snapshots are written into caller provided buffers.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Size of the data stack. */
+#define ZAGROS_DATA_STACK_SIZE 32
+
+/** Size of the address stack. */
+#define ZAGROS_ADDRESS_STACK_SIZE 128
+
+/** Size of the register bank. */
+#define ZAGROS_REGISTER_BANK_SIZE 24
+
+/** Size of the memory. */
+#define ZAGROS_MEMORY_SIZE 65535
+
+/** Number of cores. */
+#define ZAGROS_CORE_COUNT 2
+
+/** Size of the I/O table. */
+#define ZAGROS_IO_TABLE_SIZE 16
+
+/**
+ * Reasons a call or a run stopped. Values are stable, new reasons are only ever appended.
+ */
+typedef enum zagros_error {
+  ZAGROS_OK = 0,
+  ZAGROS_DIVISION_BY_ZERO = 1,
+  ZAGROS_INVALID_FLOAT_OPERATION = 2,
+  ZAGROS_OUT_OF_MEMORY = 3,
+  ZAGROS_DATA_STACK_OVERFLOW = 4,
+  ZAGROS_DATA_STACK_UNDERFLOW = 5,
+  ZAGROS_ADDRESS_STACK_OVERFLOW = 6,
+  ZAGROS_ADDRESS_STACK_UNDERFLOW = 7,
+  ZAGROS_ILLEGAL_REGISTER_ID = 8,
+  ZAGROS_ILLEGAL_MEMORY_ADDRESS = 9,
+  ZAGROS_ILLEGAL_INTERRUPT_ID = 10,
+  ZAGROS_ILLEGAL_COUNTER_ID = 11,
+  ZAGROS_INSTRUCTION_LIMIT_REACHED = 12,
+  ZAGROS_REPLAY_DIVERGENCE = 13,
+  ZAGROS_SYSTEM_HALT = 14,
+  ZAGROS_ILLEGAL_CORE_ID = 15,
+  ZAGROS_BREAKPOINT = 16,
+  ZAGROS_WATCHPOINT = 17,
+  ZAGROS_ILLEGAL_OPERAND = 18,
+
+  /** A handle or argument passed to the API is invalid. */
+  ZAGROS_INVALID_ARGUMENT = 255
+} zagros_error;
+
+/** An opaque VM handle. */
+typedef struct zagros_vm zagros_vm;
+
+/**
+ * An I/O callback, called when the guest invokes an I/O id.
+ * @param vm The VM invoking the I/O.
+ * @param io_id The I/O id.
+ * @param user_data The user data given when the callback was set.
+ */
+typedef void (*zagros_io_fn)(zagros_vm *vm, uint32_t io_id, void *user_data);
+
+/**
+ * The state of a core, written by `zagros_get_core_state`.
+ */
+typedef struct zagros_core_state {
+  /** The instruction pointer. */
+  uint32_t ip;
+
+  /** Whether the core is active, 0 or 1. */
+  uint8_t active;
+
+  /** The operation mode: 0 signed, 1 unsigned, 2 float. */
+  uint8_t op_mode;
+
+  /** The address mode: 0 direct, 1 relative. */
+  uint8_t addr_mode;
+
+  /** The number of cells on the data stack. */
+  uint32_t data_depth;
+
+  /** The data stack, bottom first. */
+  int32_t data[ZAGROS_DATA_STACK_SIZE];
+
+  /** The number of cells on the address stack. */
+  uint32_t addr_depth;
+
+  /** The address stack, bottom first. */
+  uint32_t addrs[ZAGROS_ADDRESS_STACK_SIZE];
+
+  /** The register bank. */
+  int32_t regs[ZAGROS_REGISTER_BANK_SIZE];
+} zagros_core_state;
+
+/**
+ * Creates a VM with zeroed memory and no I/O callbacks.
+ * @return The VM, NULL if it couldn't be allocated.
+ */
+zagros_vm *zagros_create(void);
+
+/**
+ * Destroys a VM.
+ * @param vm The VM, may be NULL.
+ */
+void zagros_destroy(zagros_vm *vm);
+
+/**
+ * Loads a program at address 0.
+ * @param vm The VM.
+ * @param program The program.
+ * @param len The size of the program.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if the program doesn't fit into memory.
+ */
+zagros_error zagros_load(zagros_vm *vm, const uint8_t *program, size_t len);
+
+/**
+ * Runs the VM until it halts or an error occurs.
+ * @param vm The VM.
+ * @return The reason the VM stopped, ZAGROS_SYSTEM_HALT if it halted.
+ */
+zagros_error zagros_run(zagros_vm *vm);
+
+/**
+ * Runs the VM until it halts, an error occurs or it executed a number of instructions.
+ * @param vm The VM.
+ * @param instructions The instruction budget.
+ * @return The reason the VM stopped, ZAGROS_INSTRUCTION_LIMIT_REACHED if the budget is spent.
+ */
+zagros_error zagros_run_for(zagros_vm *vm, uint64_t instructions);
+
+/**
+ * Executes a single instruction.
+ * @param vm The VM.
+ * @return ZAGROS_OK if the instruction was executed, the reason the VM stopped otherwise.
+ */
+zagros_error zagros_step(zagros_vm *vm);
+
+/**
+ * Gets the VM's memory for direct access, without copying it.
+ * @param vm The VM.
+ * @return The first of ZAGROS_MEMORY_SIZE bytes, valid as long as the VM.
+ */
+uint8_t *zagros_memory(zagros_vm *vm);
+
+/**
+ * Copies bytes out of the VM's memory.
+ * @param vm The VM.
+ * @param addr The address to read at.
+ * @param out The buffer to copy into.
+ * @param len The number of bytes.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if the range isn't in memory.
+ */
+zagros_error zagros_read_memory(zagros_vm *vm, size_t addr, uint8_t *out, size_t len);
+
+/**
+ * Copies bytes into the VM's memory.
+ * @param vm The VM.
+ * @param addr The address to write at.
+ * @param bytes The bytes.
+ * @param len The number of bytes.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if the range isn't in memory.
+ */
+zagros_error zagros_write_memory(zagros_vm *vm, size_t addr, const uint8_t *bytes, size_t len);
+
+/**
+ * Sets the callback of an I/O id.
+ * @param vm The VM.
+ * @param io_id The I/O id.
+ * @param fn The callback, NULL to call nothing.
+ * @param user_data Passed to the callback as is.
+ * @return ZAGROS_OK, or ZAGROS_INVALID_ARGUMENT if the I/O id is invalid.
+ */
+zagros_error zagros_set_io_callback(zagros_vm *vm, uint32_t io_id, zagros_io_fn fn, void *user_data);
+
+/**
+ * Writes the state of a core into a caller provided buffer.
+ * @param vm The VM.
+ * @param core_id The core.
+ * @param out The buffer.
+ * @return ZAGROS_OK, or ZAGROS_INVALID_ARGUMENT if the core doesn't exist.
+ */
+zagros_error zagros_get_core_state(zagros_vm *vm, uint32_t core_id, zagros_core_state *out);
+
+/**
+ * Sets a breakpoint at an instruction. The VM stops with ZAGROS_BREAKPOINT before executing it.
+ * @param vm The VM.
+ * @param addr The address of the instruction.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if the address isn't in memory.
+ */
+zagros_error zagros_set_breakpoint(zagros_vm *vm, uint32_t addr);
+
+/**
+ * Clears a breakpoint.
+ * @param vm The VM.
+ * @param addr The address of the instruction.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if there is no breakpoint at the address.
+ */
+zagros_error zagros_clear_breakpoint(zagros_vm *vm, uint32_t addr);
+
+/**
+ * Makes the next run execute the instruction the VM stopped at instead of stopping at its breakpoint again.
+ * @param vm The VM.
+ * @return ZAGROS_OK.
+ */
+zagros_error zagros_step_over_breakpoint(zagros_vm *vm);
+
+/**
+ * Watches a range of memory. The VM stops with ZAGROS_WATCHPOINT after an instruction writes to it.
+ * @param vm The VM.
+ * @param addr The address of the range.
+ * @param len The length of the range.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if the range isn't in memory or is empty.
+ */
+zagros_error zagros_set_watchpoint(zagros_vm *vm, size_t addr, size_t len);
+
+/**
+ * Stops watching a range of memory.
+ * @param vm The VM.
+ * @param addr The address of the range.
+ * @param len The length of the range.
+ * @return ZAGROS_OK, or ZAGROS_ILLEGAL_MEMORY_ADDRESS if the range wasn't watched.
+ */
+zagros_error zagros_clear_watchpoint(zagros_vm *vm, size_t addr, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZAGROS_C
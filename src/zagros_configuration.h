@@ -6,6 +6,7 @@
 #define ZAGROS_CONFIGURATION
 
 
+#include <cstdint>
 #include <cstdlib>
 
 // This file includes all the size configurations of the virtual machine
@@ -37,6 +38,51 @@ static const size_t IO_MEMORY_ADDRESS_END = 192;
 /// Number of cores of the virtual machine
 static const size_t CORE_COUNT = 2;
 
+/// Number of entries in each core`s execution trace ring buffer (must be a power of two)
+static const size_t EXECUTION_TRACE_SIZE = 64;
+
+/// Number of events a timeline recorder buffers before writing them out
+static const size_t TIMELINE_BUFFER_SIZE = 4096;
+
+/// Size of a memory page tracked for dirty page reset
+static const size_t MEMORY_PAGE_SIZE = 256;
+
+/// Number of memory pages
+static const size_t MEMORY_PAGE_COUNT = (MEMORY_SIZE + MEMORY_PAGE_SIZE - 1) / MEMORY_PAGE_SIZE;
+
+/// The trap opcode fetched in place of instructions with a breakpoint (`BK`)
+static const uint8_t BREAKPOINT_OPCODE = 56;
+
+/// Size of the edge coverage bitmap, the size AFL uses (must be a power of two)
+static const size_t COVERAGE_MAP_SIZE = 65536;
+
+/// Largest block copy done inline instead of calling `memmove`
+static const size_t INLINE_COPY_SIZE = 16;
+
+/// Smallest array `SO` sorts by radix sort instead of introsort
+static const size_t RADIX_SORT_MIN_SIZE = 256;
+
+/// Number of cells moved at once between a stack and its spill region in memory (must fit into both stacks)
+static const size_t STACK_SPILL_BLOCK = 16;
+
+/// Log2 of the smallest guest heap block, header included
+static const uint32_t HEAP_MIN_BLOCK_BITS = 3;
+
+/// Number of guest heap size classes, blocks are powers of two up to `1 << (HEAP_MIN_BLOCK_BITS + count - 1)` bytes
+static const uint32_t HEAP_SIZE_CLASS_COUNT = 14;
+
+/// Size of a guest hash table`s header, its control bytes start after it
+static const size_t HASH_TABLE_HEADER_SIZE = 16;
+
+/// Number of guest hash table slots probed at once (the width of an SSE2 register)
+static const size_t HASH_TABLE_GROUP_SIZE = 16;
+
+/// Number of partial sums a DSP dot product keeps, enough to fill a vector register
+static const size_t DSP_LANES = 8;
+
+/// Side of the square blocks `MM` multiplies matrices in, a block of words fits into an L1 cache
+static const size_t DSP_BLOCK_SIZE = 64;
+
 
 
 #endif //ZAGROS_CONFIGURATION
\ No newline at end of file
@@ -1,8 +1,20 @@
-%module(directors="1") Zagros
+%module(directors="1", threads="1") Zagros
+
+/* Only running or stepping a vm releases the GIL, so Python hosts can run vms on several threads.
+ * Director callbacks take the GIL back while they run. */
+%nothread;
+%thread VM::run;
+%thread VM::run_for;
+%thread VM::step;
 
 %{
  /* Includes the header in the wrapper code */
 #include "../src/vm.hpp"
+
+/* Wraps C++ owned bytes in a memoryview without copying them, see `_owned_view`. */
+static PyObject *zagros_memory_view(const uint8_t *data, Py_ssize_t size) {
+  return PyMemoryView_FromMemory(reinterpret_cast<char *>(const_cast<uint8_t *>(data)), size, PyBUF_WRITE);
+}
 %}
 
 %feature("director") Callback;
@@ -43,6 +55,7 @@ typedef unsigned char uint8_t;
 %include "../src/cell.hpp"
 
 %template(StringVector) std::vector<std::string>;
+%template(ByteVector) std::vector<uint8_t>;
 %template(MemoryArray) std::array<uint8_t, MEMORY_SIZE >;
 %template(AddressArray) std::array<Cell,ADDRESS_STACK_SIZE >;
 %template(DataArray) std::array<Cell,DATA_STACK_SIZE >;
@@ -50,12 +63,57 @@ typedef unsigned char uint8_t;
 %template(RegisterArray) std::array<Cell,REGISTER_BANK_SIZE >;
 
 %include "../src/snapshot.hpp"
+%template(IoStatsVector) std::vector<IoStatsSnapshot>;
 %template(CoreSnapshotArray) std::array<CoreSnapshot,CORE_COUNT >;
 
 %template(CallbackArray) std::array<Callback*, IO_TABLE_SIZE>;
+%include "../src/histogram.hpp"
 %include "../src/io.h"
+%template(IoRequestVector) std::vector<IoRequest>;
+%include "../src/exec_trace.hpp"
+%include "../src/disassembler.hpp"
+%include "../src/perf.hpp"
+%include "../src/metrics.hpp"
+%include "../src/timeline.hpp"
+%include "../src/replay.hpp"
 
 /* Parse the header file to generate wrappers */
 %include "../src/vm.hpp"
 
+%pythoncode %{
+def _owned_view(owner, view, readonly):
+    """Ties a memoryview of C++ owned bytes to the object owning them, so they outlive the view."""
+    import ctypes
+    buf = (ctypes.c_uint8 * view.nbytes).from_buffer(view)
+    buf._owner = owner
+    view = memoryview(buf).cast('B')
+    return view.toreadonly() if readonly else view
+%}
 
+/* Zero-copy views through the buffer protocol, e.g. numpy.frombuffer(vm.memory(), numpy.uint8) */
+%extend VM {
+  PyObject *_memory_view() {
+    uint8_t *data = $self->memory_data();
+    if (data == nullptr) {
+      PyErr_SetString(PyExc_RuntimeError, "guest memory can't be accessed directly while recording a replay log");
+      return nullptr;
+    }
+    return zagros_memory_view(data, MEMORY_SIZE);
+  }
+  %pythoncode %{
+    def memory(self):
+        """Gets the guest memory as a writable memoryview of bytes, without copying it."""
+        return _owned_view(self, self._memory_view(), False)
+  %}
+}
+
+%extend MemorySnapshot {
+  PyObject *_view() {
+    return zagros_memory_view($self->data(), MEMORY_SIZE);
+  }
+  %pythoncode %{
+    def view(self):
+        """Gets the memory as a read-only memoryview of bytes, without copying it."""
+        return _owned_view(self, self._view(), True)
+  %}
+}
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "../src/vm.hpp"
+#include "../src/fuzz.hpp"
+#include "../src/zagros_c.h"
 
 TEST(DataStack, PushPop) {
   auto stack = DataStack{};
@@ -433,6 +435,26 @@ enum class OpCode {
   BC,
   UU,
   FF,
+  PF,
+  BK,
+  HP,
+  AL,
+  FR,
+  AR,
+  JI,
+  JT,
+  CI,
+  CT,
+  SO,
+  BS,
+  HN,
+  HL,
+  HA,
+  HD,
+  DP,
+  FI,
+  MM,
+  FT,
 };
 
 using program = std::vector<std::variant<OpCode, uint8_t, uint16_t, uint32_t>>;
@@ -465,11 +487,7 @@ auto loaded_vm(const program &prg) -> VM {
     }, instr);
   }
 
-  VM vm = {};
-  std::array<uint8_t, 65535> byte_arr{};
-  std::copy_n(bytes.begin(), 65535, byte_arr.begin());
-  vm.load_program(byte_arr, bytes.size());
-  return vm;
+  return std::get<1>(VM::create(bytes.data(), bytes.size()));
 }
 
 TEST(VM, LoadMemoryWorks) {
@@ -1473,25 +1491,68 @@ TEST(VM, InstructionPauseCoreWorks) {
   prg.push_back(OpCode::LB); // 00
   prg.push_back((uint8_t) 137); // 01
   prg.push_back(OpCode::LB); // 02
-  prg.push_back((uint8_t) 7); // 03
+  prg.push_back((uint8_t) 1); // 03
   prg.push_back(OpCode::IC); // 04
   prg.push_back(OpCode::LB); // 05
-  prg.push_back((uint8_t) 7); // 06
+  prg.push_back((uint8_t) 1); // 06
   prg.push_back(OpCode::AC); // 07
   prg.push_back(OpCode::LB); // 08
-  prg.push_back((uint8_t) 7); // 09
+  prg.push_back((uint8_t) 1); // 09
   prg.push_back(OpCode::PC); // 10
   prg.push_back(OpCode::HS); // 11
   auto vm = loaded_vm(prg);
   vm.run();
   auto const &ss = vm.snapshot();
   auto core = ss.get_cores()[0];
-  auto core_to_pause = ss.get_cores()[7];
+  auto core_to_pause = ss.get_cores()[1];
   ASSERT_EQ(core_to_pause.is_active(), false);
   ASSERT_EQ(core.get_ip(), 11);
   ASSERT_EQ(core.get_op_mode(), OpMode::SIGNED);
 }
 
+TEST(VM, CoreInstructionsRejectIllegalCoreIds) {
+  for (auto op: {OpCode::IC, OpCode::AC, OpCode::PC}) {
+    program prg;
+    prg.push_back(OpCode::LB); // 00
+    prg.push_back((uint8_t) 137); // 01
+    prg.push_back(OpCode::LB); // 02
+    prg.push_back((uint8_t) CORE_COUNT); // 03
+    prg.push_back(op); // 04
+    prg.push_back(OpCode::HS); // 05
+    auto vm = loaded_vm(prg);
+    auto const &[err, _] = vm.run();
+    ASSERT_EQ(err, ZError::IllegalCoreId);
+    auto core = vm.snapshot().get_cores()[0];
+    ASSERT_EQ(core.get_ip(), 4);
+  }
+}
+
+TEST(VM, CoreSwitchesCountOnlySwitches) {
+  program single;
+  single.push_back(OpCode::NO); // 00
+  single.push_back(OpCode::HS); // 01
+  auto single_vm = loaded_vm(single);
+  ASSERT_EQ(std::get<0>(single_vm.run()), ZError::SystemHalt);
+  ASSERT_EQ(std::get<0>(single_vm.run()), ZError::SystemHalt);
+  ASSERT_EQ(single_vm.metrics().get_core_switches(), 0);
+
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 20); // 01
+  prg.push_back(OpCode::LB); // 02
+  prg.push_back((uint8_t) 1); // 03
+  prg.push_back(OpCode::IC); // 04
+  prg.push_back(OpCode::LB); // 05
+  prg.push_back((uint8_t) 1); // 06
+  prg.push_back(OpCode::AC); // 07
+  prg.push_back(OpCode::NO); // 08
+  prg.push_back(OpCode::HS); // 09
+  auto vm = loaded_vm(prg);
+  ASSERT_EQ(std::get<0>(vm.run()), ZError::SystemHalt);
+  // To core 1 and back before each of core 0`s `NO` and `HS`.
+  ASSERT_EQ(vm.metrics().get_core_switches(), 4);
+}
+
 TEST(VM, InstructionSuspendCurrentCoreWorks) {
   program prg;
   prg.push_back(OpCode::SC); // 00
@@ -1689,12 +1750,7 @@ auto loaded_vm(const program &prg, std::array<Callback*, IO_TABLE_SIZE> callback
     }, instr);
   }
 
-  auto io_table = IoTable {callbacks};
-  VM vm = VM(io_table);
-  std::array<uint8_t, 65535> byte_arr{};
-  std::copy_n(bytes.begin(), 65535, byte_arr.begin());
-  vm.load_program(byte_arr, bytes.size());
-  return vm;
+  return std::get<1>(VM::create(bytes.data(), bytes.size(), IoTable{callbacks}));
 }
 
 TEST(VM, InvokeIOWorks) {
@@ -1724,3 +1780,1603 @@ TEST(VM, InvokeIOWorks) {
   }
 }
 
+
+TEST(ExecutionTrace, RecordWraps) {
+  auto trace = ExecutionTrace{};
+  auto stack = DataStack{};
+  for (uint32_t i = 0; i < EXECUTION_TRACE_SIZE + 3; ++i) {
+    stack.clear();
+    stack.push(Cell{i * 2});
+    trace.record(i, 1, stack);
+  }
+  ASSERT_EQ(trace.size(), EXECUTION_TRACE_SIZE);
+  auto const oldest = trace.at(0);
+  EXPECT_EQ(oldest.ip, 3);
+  EXPECT_EQ(oldest.tos, 6);
+  EXPECT_EQ(oldest.depth, 1);
+  auto const newest = trace.at(EXECUTION_TRACE_SIZE - 1);
+  EXPECT_EQ(newest.ip, EXECUTION_TRACE_SIZE + 2);
+}
+
+TEST(VM, ExecutionTraceDumpedOnError) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 42); // 01
+  prg.push_back(OpCode::DR); // 02
+  prg.push_back(OpCode::DR); // 03
+  auto vm = loaded_vm(prg);
+  vm.enable_trace(true);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::DataStackUnderflow);
+
+  auto const &dump = vm.get_trace_dump();
+  ASSERT_FALSE(dump.empty());
+  auto const text = Disassembler::decode_trace(dump);
+  EXPECT_EQ(text, "core 0:\n  0: LB depth: 0\n  2: DR depth: 1 tos: 42\n  3: DR depth: 0\ncore 1:\n");
+}
+
+TEST(VM, ExecutionTraceNotDumpedOnHalt) {
+  program prg;
+  prg.push_back(OpCode::HS); // 00
+  auto vm = loaded_vm(prg);
+  vm.enable_trace(true);
+  vm.run();
+  EXPECT_TRUE(vm.get_trace_dump().empty());
+}
+
+TEST(Disassembler, DisassembleWorks) {
+  const uint8_t code[] = {3, 7, 2, 0x39, 0x05, 44};
+  auto const text = Disassembler::disassemble(code, sizeof(code), 0, sizeof(code));
+  EXPECT_EQ(text, "0: LB 7\n2: LH 1337\n5: HS\n");
+}
+
+TEST(Perf, RegionNameWorks) {
+  EXPECT_EQ(perf_region_name(0x42, ""), "zagros:0x42");
+  EXPECT_EQ(perf_region_name(0x1F0, "main"), "zagros:main@0x1f0");
+}
+
+static auto read_file(const std::string &path) -> std::string {
+  std::string bytes;
+  auto file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return bytes;
+  }
+  char buffer[256];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.append(buffer, read);
+  }
+  fclose(file);
+  return bytes;
+}
+
+template<typename T>
+static auto read_at(const std::string &bytes, size_t offset) -> T {
+  T value;
+  memcpy(&value, bytes.data() + offset, sizeof(T));
+  return value;
+}
+
+TEST(Perf, PerfMapWritesLines) {
+  const auto path = "/tmp/zagros-test-" + std::to_string(getpid()) + ".map";
+  remove(path.c_str());
+  PerfMap map;
+  if (!map.open(path.c_str())) {
+    GTEST_SKIP();
+  }
+  const uint8_t code[] = {0x90, 0xC3};
+  map.add(code, sizeof(code), perf_region_name(0x10, "main"));
+  map.add(code + 1, 1, perf_region_name(0x20, ""));
+  map.close();
+
+  char expected[128];
+  snprintf(expected, sizeof(expected), "%lx 2 zagros:main@0x10\n%lx 1 zagros:0x20\n",
+           reinterpret_cast<unsigned long>(code), reinterpret_cast<unsigned long>(code + 1));
+  EXPECT_EQ(read_file(path), expected);
+  remove(path.c_str());
+}
+
+TEST(Perf, JitDumpWritesHeaderAndRecords) {
+  const auto path = "/tmp/zagros-test-" + std::to_string(getpid()) + ".dump";
+  remove(path.c_str());
+  JitDump dump;
+  if (!dump.open(path.c_str())) {
+    GTEST_SKIP();
+  }
+  const uint8_t code[] = {0x90, 0x90, 0xC3};
+  const std::string name = "zagros:main@0x10";
+  dump.add(code, sizeof(code), name);
+  dump.add(code, sizeof(code), name);
+  dump.close();
+
+  auto const bytes = read_file(path);
+  const uint32_t record_size = 16 + 8 + 4 * 8 + name.size() + 1 + sizeof(code);
+  ASSERT_EQ(bytes.size(), 40 + 2 * record_size);
+
+  EXPECT_EQ(read_at<uint32_t>(bytes, 0), 0x4A695444);
+  EXPECT_EQ(read_at<uint32_t>(bytes, 4), 1);
+  EXPECT_EQ(read_at<uint32_t>(bytes, 8), 40);
+  EXPECT_EQ(read_at<uint32_t>(bytes, 16), 0);
+  EXPECT_EQ(read_at<uint32_t>(bytes, 20), static_cast<uint32_t>(getpid()));
+  EXPECT_EQ(read_at<uint64_t>(bytes, 32), 0);
+
+  const auto addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(code));
+  for (uint64_t index = 0; index < 2; ++index) {
+    const size_t record = 40 + index * record_size;
+    EXPECT_EQ(read_at<uint32_t>(bytes, record), 0);
+    EXPECT_EQ(read_at<uint32_t>(bytes, record + 4), record_size);
+    EXPECT_EQ(read_at<uint32_t>(bytes, record + 16), static_cast<uint32_t>(getpid()));
+    EXPECT_EQ(read_at<uint64_t>(bytes, record + 24), addr);
+    EXPECT_EQ(read_at<uint64_t>(bytes, record + 32), addr);
+    EXPECT_EQ(read_at<uint64_t>(bytes, record + 40), sizeof(code));
+    EXPECT_EQ(read_at<uint64_t>(bytes, record + 48), index);
+    EXPECT_EQ(bytes.substr(record + 56, name.size() + 1), std::string(name.c_str(), name.size() + 1));
+    EXPECT_EQ(bytes.substr(record + 56 + name.size() + 1, sizeof(code)),
+              std::string(reinterpret_cast<const char *>(code), sizeof(code)));
+  }
+  EXPECT_GE(read_at<uint64_t>(bytes, 40 + record_size + 8), read_at<uint64_t>(bytes, 40 + 8));
+  remove(path.c_str());
+}
+
+TEST(VM, HostCountersAroundRun) {
+  program prg;
+  prg.push_back(OpCode::HS); // 00
+  auto vm = loaded_vm(prg);
+  HostCounters counters;
+  const auto available = counters.open();
+  vm.set_host_counters(&counters);
+  vm.run();
+  vm.set_host_counters(nullptr);
+  auto const values = vm.get_host_counter_values();
+  if (available) {
+    EXPECT_GT(values.cycles, 0);
+  } else {
+    EXPECT_EQ(values.cycles, 0);
+  }
+}
+
+TEST(LatencyHistogram, PercentilesWork) {
+  auto histogram = LatencyHistogram{};
+  EXPECT_EQ(histogram.percentile(50.0), 0);
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    histogram.record(i);
+  }
+  EXPECT_EQ(histogram.get_count(), 1000);
+  EXPECT_EQ(histogram.get_max(), 1000);
+  auto const p50 = histogram.percentile(50.0);
+  EXPECT_GE(p50, 500);
+  EXPECT_LE(p50, 500 * 9 / 8);
+  auto const p99 = histogram.percentile(99.0);
+  EXPECT_GE(p99, 990);
+  EXPECT_LE(p99, 1000);
+  EXPECT_EQ(histogram.percentile(100.0), 1000);
+}
+
+TEST(LatencyHistogram, SmallValuesAreExact) {
+  auto histogram = LatencyHistogram{};
+  histogram.record(3);
+  histogram.record(5);
+  EXPECT_EQ(histogram.percentile(50.0), 3);
+  EXPECT_EQ(histogram.percentile(100.0), 5);
+}
+
+TEST(VM, IoStatsWork) {
+  program prg;
+  std::array<Callback*, IO_TABLE_SIZE> callbacks{};
+  auto callback = TestCallback(3);
+  callbacks[3] = &callback;
+  for (int i = 0; i < 5; ++i) {
+    prg.push_back(OpCode::LB);
+    prg.push_back((uint8_t) 3);
+    prg.push_back(OpCode::II);
+  }
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg, callbacks);
+  vm.enable_io_stats(true);
+  vm.run();
+  auto const io_table = vm.snapshot().get_io_table();
+  auto const &stats = io_table.get_stats();
+  ASSERT_EQ(stats.size(), IO_TABLE_SIZE);
+  EXPECT_EQ(stats[3].get_calls(), 5);
+  EXPECT_LE(stats[3].get_p50(), stats[3].get_max());
+  EXPECT_EQ(stats[0].get_calls(), 0);
+}
+
+TEST(VM, IoStatsDisabledByDefault) {
+  auto vm = VM{};
+  EXPECT_TRUE(vm.snapshot().get_io_table().get_stats().empty());
+}
+
+TEST(VM, MetricsWork) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 1); // 01
+  prg.push_back(OpCode::TI); // 02
+  prg.push_back(OpCode::LB); // 03
+  prg.push_back((uint8_t) 200); // 04
+  prg.push_back(OpCode::II); // 05
+  prg.push_back(OpCode::HS); // 06
+  auto vm = loaded_vm(prg);
+  vm.run();
+  vm.io_write(IO_MEMORY_ADDRESS_END, 0);
+  auto const metrics = vm.metrics();
+  EXPECT_EQ(metrics.get_instructions_retired(), 5);
+  EXPECT_GT(metrics.get_cycles(), 0);
+  EXPECT_EQ(metrics.get_interrupts_delivered(), 0);
+  EXPECT_EQ(metrics.get_interrupts_masked(), 1);
+  EXPECT_EQ(metrics.get_io_calls(), 1);
+  EXPECT_EQ(metrics.get_io_errors(), 2);
+  EXPECT_EQ(metrics.get_stops(ZError::SystemHalt), 1);
+  EXPECT_EQ(metrics.get_stops(ZError::DataStackUnderflow), 0);
+}
+
+TEST(VM, MetricsMergeWorks) {
+  program prg;
+  prg.push_back(OpCode::NO); // 00
+  prg.push_back(OpCode::HS); // 01
+  auto first = loaded_vm(prg);
+  auto second = loaded_vm(prg);
+  first.run();
+  second.run();
+  second.run();
+  auto metrics = first.metrics();
+  metrics.merge(second.metrics());
+  EXPECT_EQ(metrics.get_instructions_retired(), 5);
+  EXPECT_EQ(metrics.get_stops(ZError::SystemHalt), 3);
+}
+
+TEST(VM, MetricsCountParkedCycles) {
+  program prg;
+  prg.push_back(OpCode::SC); // 00
+  prg.push_back(OpCode::HS); // 01
+  auto vm = loaded_vm(prg);
+  vm.run();
+  // The halted vm`s cores stay parked, so parked cycles grow while the host waits.
+  auto const before = vm.metrics().get_parked_cycles();
+  auto const start = cycle_now();
+  while (cycle_now() - start < 10000) {
+  }
+  auto const after = vm.metrics().get_parked_cycles();
+  EXPECT_GE(after - before, 10000u);
+}
+
+auto count_occurrences(const std::string &text, const std::string &needle) -> size_t {
+  size_t count = 0;
+  for (auto at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+    count += 1;
+  }
+  return count;
+}
+
+TEST(VM, TimelineWorks) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 1); // 01
+  prg.push_back(OpCode::AC); // 02
+  prg.push_back(OpCode::SC); // 03
+  prg.push_back(OpCode::HS); // 04
+  auto vm = loaded_vm(prg);
+  std::stringstream out;
+  auto recorder = TimelineRecorder(out, 1.0, 2);
+  vm.set_timeline(&recorder);
+  vm.run();
+  vm.set_timeline(nullptr);
+  recorder.finish();
+
+  auto const json = out.str();
+  EXPECT_EQ(json.rfind(R"({"displayTimeUnit":"ns","traceEvents":[)", 0), 0);
+  EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+  // Both cores run the program, interleaved instruction by instruction.
+  EXPECT_EQ(count_occurrences(json, R"("name":"running","ph":"B")"), 4);
+  EXPECT_EQ(count_occurrences(json, R"("name":"running","ph":"E")"), 4);
+  EXPECT_EQ(count_occurrences(json, R"("name":"activate core")"), 2);
+  EXPECT_EQ(count_occurrences(json, R"("name":"suspend")"), 2);
+  EXPECT_EQ(count_occurrences(json, R"("name":"thread_name")"), CORE_COUNT);
+}
+
+TEST(VM, TimelineRecordsIo) {
+  program prg;
+  std::array<Callback*, IO_TABLE_SIZE> callbacks{};
+  auto callback = TestCallback(2);
+  callbacks[2] = &callback;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 2); // 01
+  prg.push_back(OpCode::II); // 02
+  prg.push_back(OpCode::HS); // 03
+  auto vm = loaded_vm(prg, callbacks);
+  std::stringstream out;
+  auto recorder = TimelineRecorder(out);
+  vm.set_timeline(&recorder);
+  vm.run();
+  recorder.finish();
+
+  auto const json = out.str();
+  EXPECT_EQ(count_occurrences(json, R"("name":"io","ph":"B")"), 1);
+  EXPECT_EQ(count_occurrences(json, R"("name":"io","ph":"E")"), 1);
+  EXPECT_EQ(count_occurrences(json, R"("args":{"id":2})"), 2);
+}
+
+TEST(VM, InstructionPerfCounterWorks) {
+  program prg;
+  prg.push_back(OpCode::NO); // 00
+  prg.push_back(OpCode::LB); // 01
+  prg.push_back((uint8_t) PerfCounterId::RETIRED); // 02
+  prg.push_back(OpCode::PF); // 03
+  prg.push_back(OpCode::LB); // 04
+  prg.push_back((uint8_t) PerfCounterId::NANOSECONDS); // 05
+  prg.push_back(OpCode::PF); // 06
+  prg.push_back(OpCode::LB); // 07
+  prg.push_back((uint8_t) PerfCounterId::CYCLES); // 08
+  prg.push_back(OpCode::PF); // 09
+  prg.push_back(OpCode::HS); // 10
+  auto vm = loaded_vm(prg);
+  vm.run();
+  auto const &ss = vm.snapshot();
+  auto core = ss.get_cores()[0];
+  ASSERT_EQ(core.get_data().get_top(), 3);
+  EXPECT_EQ(stack_pop(core.get_data(), 2), Cell{3});
+  ASSERT_EQ(core.get_ip(), 10);
+  ASSERT_EQ(core.get_op_mode(), OpMode::SIGNED);
+}
+
+TEST(VM, InstructionPerfCounterIllegalId) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 9); // 01
+  prg.push_back(OpCode::PF); // 02
+  auto vm = loaded_vm(prg);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::IllegalCounterId);
+}
+
+TEST(VM, RunForStopsAtInstructionLimit) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 0); // 01
+  prg.push_back(OpCode::JU); // 02
+  auto vm = loaded_vm(prg);
+  auto const &[err, _] = vm.run_for(100);
+  ASSERT_EQ(err, ZError::InstructionLimitReached);
+  ASSERT_EQ(vm.metrics().get_instructions_retired(), 100);
+}
+
+auto fuzz_target() -> VM {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 204); // 01
+  prg.push_back(OpCode::FB); // 02
+  prg.push_back(OpCode::LB); // 03
+  prg.push_back((uint8_t) 'A'); // 04
+  prg.push_back(OpCode::EQ); // 05
+  prg.push_back(OpCode::LB); // 06
+  prg.push_back((uint8_t) 16); // 07
+  prg.push_back(OpCode::CJ); // 08
+  prg.push_back(OpCode::NO); // 09
+  prg.push_back(OpCode::NO); // 10
+  prg.push_back(OpCode::NO); // 11
+  prg.push_back(OpCode::HS); // 12
+  prg.push_back(OpCode::NO); // 13
+  prg.push_back(OpCode::NO); // 14
+  prg.push_back(OpCode::NO); // 15
+  prg.push_back(OpCode::LB); // 16
+  prg.push_back((uint8_t) 42); // 17
+  prg.push_back(OpCode::LB); // 18
+  prg.push_back((uint8_t) 150); // 19
+  prg.push_back(OpCode::SB); // 20
+  prg.push_back(OpCode::HS); // 21
+  return loaded_vm(prg);
+}
+
+TEST(FuzzHarness, InputsRunOnRestoredVm) {
+  FuzzHarness harness(fuzz_target(), 200, 16, 1000);
+  const uint8_t taken[] = {'A'};
+  const uint8_t not_taken[] = {'B', 'C'};
+
+  auto const &[taken_err, _1] = harness.run_one(taken, sizeof(taken));
+  ASSERT_EQ(taken_err, ZError::SystemHalt);
+  auto mem = harness.get_vm().snapshot().get_mem().get_arr();
+  ASSERT_EQ(mem[150], 42);
+  ASSERT_EQ(mem[200], 1);
+
+  auto const &[not_taken_err, _2] = harness.run_one(not_taken, sizeof(not_taken));
+  ASSERT_EQ(not_taken_err, ZError::SystemHalt);
+  mem = harness.get_vm().snapshot().get_mem().get_arr();
+  ASSERT_EQ(mem[150], 0);
+  ASSERT_EQ(mem[200], 2);
+  ASSERT_EQ(harness.get_vm().snapshot().get_cores()[0].get_ip(), 12);
+}
+
+TEST(FuzzHarness, CoverageDistinguishesEdges) {
+  FuzzHarness harness(fuzz_target(), 200, 16, 1000);
+  const uint8_t taken[] = {'A'};
+  const uint8_t not_taken[] = {'B'};
+  const auto &map = harness.get_coverage_map();
+
+  harness.run_one(taken, sizeof(taken));
+  const auto taken_map = map;
+  harness.clear_coverage_map();
+  harness.run_one(not_taken, sizeof(not_taken));
+
+  ASSERT_EQ(std::count_if(taken_map.begin(), taken_map.end(), [](uint8_t hits) { return hits != 0; }), 1);
+  ASSERT_EQ(std::count_if(map.begin(), map.end(), [](uint8_t hits) { return hits != 0; }), 1);
+  ASSERT_NE(taken_map, map);
+}
+
+TEST(FuzzHarness, InfiniteLoopsAreCutShort) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 0); // 01
+  prg.push_back(OpCode::JU); // 02
+  FuzzHarness harness(loaded_vm(prg), 200, 16, 1000);
+  auto const &[err, _] = harness.run_one(nullptr, 0);
+  ASSERT_EQ(err, ZError::InstructionLimitReached);
+}
+
+class WritingCallback : public Callback {
+ private:
+  VM *vm = nullptr;
+  uint8_t value;
+  bool called = false;
+
+ public:
+  explicit WritingCallback(uint8_t value) : value(value) {
+  }
+
+  void set_vm(VM *target) {
+    vm = target;
+  }
+
+  void run() override {
+    called = true;
+    vm->io_write(100, value);
+  }
+
+  bool is_called() const {
+    return called;
+  }
+};
+
+auto replay_program(uint8_t io_id) -> program {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back(io_id); // 01
+  prg.push_back(OpCode::II); // 02
+  prg.push_back(OpCode::LB); // 03
+  prg.push_back((uint8_t) 100); // 04
+  prg.push_back(OpCode::FB); // 05
+  prg.push_back(OpCode::LB); // 06
+  prg.push_back((uint8_t) 150); // 07
+  prg.push_back(OpCode::SB); // 08
+  prg.push_back(OpCode::LB); // 09
+  prg.push_back((uint8_t) PerfCounterId::NANOSECONDS); // 10
+  prg.push_back(OpCode::PF); // 11
+  prg.push_back(OpCode::HS); // 12
+  return prg;
+}
+
+TEST(VM, ReplayReproducesIo) {
+  ReplayLog log;
+  uint32_t recorded_ns;
+  {
+    auto callback = WritingCallback(7);
+    std::array<Callback *, IO_TABLE_SIZE> callbacks{};
+    callbacks[0] = &callback;
+    auto vm = loaded_vm(replay_program(0), callbacks);
+    callback.set_vm(&vm);
+    vm.record_replay(&log);
+    vm.io_write(120, 3);
+    auto const &[err, _] = vm.run();
+    ASSERT_EQ(err, ZError::SystemHalt);
+    recorded_ns = stack_pop(vm.snapshot().get_cores()[0].get_data(), 0).to_uint32();
+  }
+
+  ReplayLog decoded(log.get_bytes());
+  auto callback = WritingCallback(9);
+  std::array<Callback *, IO_TABLE_SIZE> callbacks{};
+  callbacks[0] = &callback;
+  auto vm = loaded_vm(replay_program(0), callbacks);
+  callback.set_vm(&vm);
+  vm.replay(&decoded);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  ASSERT_FALSE(callback.is_called());
+  auto const &ss = vm.snapshot();
+  auto const mem = ss.get_mem().get_arr();
+  ASSERT_EQ(mem[100], 7);
+  ASSERT_EQ(mem[120], 3);
+  ASSERT_EQ(mem[150], 7);
+  ASSERT_EQ(stack_pop(ss.get_cores()[0].get_data(), 0), Cell{recorded_ns});
+}
+
+TEST(VM, ReplayDetectsDivergence) {
+  ReplayLog log;
+  {
+    auto callback = WritingCallback(7);
+    std::array<Callback *, IO_TABLE_SIZE> callbacks{};
+    callbacks[0] = &callback;
+    auto vm = loaded_vm(replay_program(0), callbacks);
+    callback.set_vm(&vm);
+    vm.record_replay(&log);
+    vm.run();
+  }
+
+  auto vm = loaded_vm(replay_program(1));
+  vm.replay(&log);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::ReplayDivergence);
+}
+
+class MemoryWritingCallback : public Callback {
+ private:
+  VM *vm = nullptr;
+  uint8_t value;
+
+ public:
+  explicit MemoryWritingCallback(uint8_t value) : value(value) {
+  }
+
+  void set_vm(VM *target) {
+    vm = target;
+  }
+
+  void run() override {
+    vm->write_memory(200, &value, 1);
+  }
+};
+
+TEST(VM, ReplayReproducesHostMemoryWrites) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 0); // 01
+  prg.push_back(OpCode::II); // 02
+  prg.push_back(OpCode::LB); // 03
+  prg.push_back((uint8_t) 200); // 04
+  prg.push_back(OpCode::FB); // 05
+  prg.push_back(OpCode::HS); // 06
+
+  ReplayLog log;
+  {
+    auto callback = MemoryWritingCallback(7);
+    std::array<Callback *, IO_TABLE_SIZE> callbacks{};
+    callbacks[0] = &callback;
+    auto vm = loaded_vm(prg, callbacks);
+    callback.set_vm(&vm);
+    vm.record_replay(&log);
+    ASSERT_EQ(vm.memory_data(), nullptr);
+    const uint8_t bytes[] = {3, 4};
+    vm.write_memory(210, bytes, sizeof(bytes));
+    auto const &[err, _] = vm.run();
+    ASSERT_EQ(err, ZError::SystemHalt);
+    vm.record_replay(nullptr);
+    ASSERT_NE(vm.memory_data(), nullptr);
+  }
+
+  auto vm = loaded_vm(prg);
+  vm.replay(&log);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto const &ss = vm.snapshot();
+  auto const mem = ss.get_mem().get_arr();
+  ASSERT_EQ(mem[200], 7);
+  ASSERT_EQ(mem[210], 3);
+  ASSERT_EQ(mem[211], 4);
+  ASSERT_EQ(stack_pop(ss.get_cores()[0].get_data(), 0), Cell{7});
+}
+
+TEST(VM, MemoryDataIsShared) {
+  program prg;
+  prg.push_back(OpCode::HS); // 00
+  auto vm = loaded_vm(prg);
+  vm.memory_data()[300] = 42;
+  auto const mem = vm.snapshot().get_mem();
+  ASSERT_EQ(mem.data()[300], 42);
+  ASSERT_EQ(mem.get_arr()[300], 42);
+}
+
+TEST(VM, IoQueueBatchesRequests) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 3); // 01
+  prg.push_back(OpCode::II); // 02
+  prg.push_back(OpCode::LB); // 03
+  prg.push_back((uint8_t) 9); // 04
+  prg.push_back(OpCode::LB); // 05
+  prg.push_back((uint8_t) 101); // 06
+  prg.push_back(OpCode::SB); // 07
+  prg.push_back(OpCode::LB); // 08
+  prg.push_back((uint8_t) 5); // 09
+  prg.push_back(OpCode::II); // 10
+  prg.push_back(OpCode::HS); // 11
+  auto callback = TestCallback(3);
+  std::array<Callback *, IO_TABLE_SIZE> callbacks{};
+  callbacks[3] = &callback;
+  auto vm = loaded_vm(prg, callbacks);
+  IoRequestQueue queue;
+  auto const &[set_err, _1] = vm.set_io_queue(&queue, 100, 2);
+  ASSERT_EQ(set_err, ZError::None);
+  auto const &[err, _2] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  ASSERT_FALSE(callback.is_called());
+  ASSERT_EQ(queue.size(), 2);
+  auto const requests = queue.drain();
+  ASSERT_EQ(queue.size(), 0);
+  ASSERT_EQ(requests.size(), 2);
+  ASSERT_EQ(requests[0].get_io_id(), 3);
+  ASSERT_EQ(requests[0].get_payload(), (std::vector<uint8_t>{0, 0}));
+  ASSERT_EQ(requests[1].get_io_id(), 5);
+  ASSERT_EQ(requests[1].get_payload(), (std::vector<uint8_t>{0, 9}));
+}
+
+TEST(VM, IoQueuePayloadMustBeIoMemory) {
+  program prg;
+  prg.push_back(OpCode::HS); // 00
+  auto vm = loaded_vm(prg);
+  IoRequestQueue queue;
+  auto const &[err, _] = vm.set_io_queue(&queue, IO_MEMORY_ADDRESS_END - 1, 2);
+  ASSERT_EQ(err, ZError::IllegalMemoryAddress);
+}
+
+TEST(CApi, RunWithCallbackWorks) {
+  const uint8_t prg[] = {
+      static_cast<uint8_t>(OpCode::LB), 7,
+      static_cast<uint8_t>(OpCode::II),
+      static_cast<uint8_t>(OpCode::LB), 42,
+      static_cast<uint8_t>(OpCode::HS),
+  };
+  auto vm = zagros_create();
+  ASSERT_NE(vm, nullptr);
+  ASSERT_EQ(zagros_load(vm, prg, sizeof(prg)), ZAGROS_OK);
+  int calls = 0;
+  auto on_io = [](zagros_vm *vm, uint32_t io_id, void *user_data) {
+    *static_cast<int *>(user_data) += 1;
+    const uint8_t byte = static_cast<uint8_t>(io_id);
+    zagros_write_memory(vm, 100, &byte, 1);
+  };
+  ASSERT_EQ(zagros_set_io_callback(vm, 7, on_io, &calls), ZAGROS_OK);
+  ASSERT_EQ(zagros_set_io_callback(vm, IO_TABLE_SIZE, on_io, &calls), ZAGROS_INVALID_ARGUMENT);
+
+  ASSERT_EQ(zagros_step(vm), ZAGROS_OK);
+  zagros_core_state state;
+  ASSERT_EQ(zagros_get_core_state(vm, 0, &state), ZAGROS_OK);
+  ASSERT_EQ(state.ip, 2);
+  ASSERT_EQ(state.data_depth, 1);
+  ASSERT_EQ(state.data[0], 7);
+
+  ASSERT_EQ(zagros_run(vm), ZAGROS_SYSTEM_HALT);
+  ASSERT_EQ(calls, 1);
+  uint8_t byte = 0;
+  ASSERT_EQ(zagros_read_memory(vm, 100, &byte, 1), ZAGROS_OK);
+  ASSERT_EQ(byte, 7);
+  ASSERT_EQ(zagros_memory(vm)[100], 7);
+  ASSERT_EQ(zagros_read_memory(vm, MEMORY_SIZE, &byte, 1), ZAGROS_ILLEGAL_MEMORY_ADDRESS);
+  ASSERT_EQ(zagros_get_core_state(vm, CORE_COUNT, &state), ZAGROS_INVALID_ARGUMENT);
+  zagros_destroy(vm);
+}
+
+TEST(VM, StepRoundRobinsCores) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 20); // 01
+  prg.push_back(OpCode::LB); // 02
+  prg.push_back((uint8_t) 1); // 03
+  prg.push_back(OpCode::IC); // 04
+  prg.push_back(OpCode::LB); // 05
+  prg.push_back((uint8_t) 1); // 06
+  prg.push_back(OpCode::AC); // 07
+  prg.push_back(OpCode::LB); // 08
+  prg.push_back((uint8_t) 8); // 09
+  prg.push_back(OpCode::JU); // 10
+  for (int i = 11; i < 20; ++i) {
+    prg.push_back(OpCode::NO);
+  }
+  prg.push_back(OpCode::LB); // 20
+  prg.push_back((uint8_t) 20); // 21
+  prg.push_back(OpCode::JU); // 22
+  auto vm = loaded_vm(prg);
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_EQ(std::get<0>(vm.step()), ZError::None);
+  }
+  ASSERT_EQ(vm.core_snapshot(0).get_ip(), 8);
+  ASSERT_EQ(std::get<0>(vm.step()), ZError::None);
+  ASSERT_EQ(vm.core_snapshot(1).get_ip(), 22);
+  ASSERT_EQ(std::get<0>(vm.step()), ZError::None);
+  ASSERT_EQ(vm.core_snapshot(0).get_ip(), 10);
+  ASSERT_EQ(std::get<0>(vm.step()), ZError::None);
+  ASSERT_EQ(vm.core_snapshot(1).get_ip(), 20);
+  ASSERT_EQ(std::get<0>(vm.run_for(1)), ZError::InstructionLimitReached);
+  ASSERT_EQ(vm.core_snapshot(0).get_ip(), 8);
+  ASSERT_EQ(vm.metrics().get_stops(ZError::InstructionLimitReached), 1);
+}
+
+TEST(VM, BreakpointStopsAndStepsOver) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 1); // 01
+  prg.push_back(OpCode::LB); // 02
+  prg.push_back((uint8_t) 2); // 03
+  prg.push_back(OpCode::AD); // 04
+  prg.push_back(OpCode::HS); // 05
+  auto vm = loaded_vm(prg);
+  auto const &[set_err, _1] = vm.set_breakpoint(4);
+  ASSERT_EQ(set_err, ZError::None);
+
+  auto const &[err, _2] = vm.run();
+  ASSERT_EQ(err, ZError::Breakpoint);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 4);
+  ASSERT_EQ(core.get_data().get_top(), 2);
+  ASSERT_EQ(vm.metrics().get_instructions_retired(), 2);
+
+  auto const &[again_err, _3] = vm.run();
+  ASSERT_EQ(again_err, ZError::Breakpoint);
+
+  vm.step_over_breakpoint();
+  auto const &[resumed_err, _4] = vm.run();
+  ASSERT_EQ(resumed_err, ZError::SystemHalt);
+  core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 5);
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{3});
+
+  auto const &[clear_err, _5] = vm.clear_breakpoint(4);
+  ASSERT_EQ(clear_err, ZError::None);
+  ASSERT_EQ(vm.snapshot().get_mem().get_arr()[4], static_cast<uint8_t>(OpCode::AD));
+  auto const &[missing_err, _6] = vm.clear_breakpoint(4);
+  ASSERT_EQ(missing_err, ZError::IllegalMemoryAddress);
+}
+
+TEST(VM, BreakpointsAreInvisibleToReadsAndSurviveRestore) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 4); // 01
+  prg.push_back(OpCode::FB); // 02
+  prg.push_back(OpCode::NO); // 03
+  prg.push_back(OpCode::UU); // 04
+  prg.push_back(OpCode::NO); // 05
+  prg.push_back(OpCode::HS); // 06
+  auto base = loaded_vm(prg);
+  auto const &[set_err, _1] = base.set_breakpoint(4);
+  ASSERT_EQ(set_err, ZError::None);
+  ASSERT_EQ(base.snapshot().get_mem().get_arr()[4], static_cast<uint8_t>(OpCode::UU));
+  ASSERT_EQ(base.memory_data()[4], static_cast<uint8_t>(OpCode::UU));
+
+  auto vm = base;
+  // Dirty the breakpoint`s page, so restoring copies it back.
+  const uint8_t byte = static_cast<uint8_t>(OpCode::NO);
+  vm.write_memory(5, &byte, 1);
+  vm.restore(base);
+  for (int i = 0; i < 2; ++i) {
+    auto const &[err, _2] = vm.run();
+    ASSERT_EQ(err, ZError::Breakpoint);
+    auto core = vm.snapshot().get_cores()[0];
+    ASSERT_EQ(core.get_ip(), 4);
+    // The guest loads the instruction, not the trap.
+    ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{static_cast<uint32_t>(OpCode::UU)});
+    vm.restore(base);
+  }
+}
+
+TEST(VM, BreakpointsSurviveWrites) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 1); // 01
+  prg.push_back(OpCode::LB); // 02
+  prg.push_back((uint8_t) 2); // 03
+  prg.push_back(OpCode::AD); // 04
+  prg.push_back(OpCode::HS); // 05
+  auto vm = loaded_vm(prg);
+  vm.set_breakpoint(4);
+  // Replace the instruction under the breakpoint.
+  const uint8_t byte = static_cast<uint8_t>(OpCode::SU);
+  vm.write_memory(4, &byte, 1);
+  uint8_t read;
+  vm.read_memory(4, &read, 1);
+  ASSERT_EQ(read, static_cast<uint8_t>(OpCode::SU));
+
+  auto const &[err, _1] = vm.run();
+  ASSERT_EQ(err, ZError::Breakpoint);
+  vm.step_over_breakpoint();
+  auto const &[resumed_err, _2] = vm.run();
+  ASSERT_EQ(resumed_err, ZError::SystemHalt);
+  ASSERT_EQ(stack_pop(vm.snapshot().get_cores()[0].get_data(), 0), Cell{-1});
+
+  vm.clear_breakpoint(4);
+  ASSERT_EQ(vm.snapshot().get_mem().get_arr()[4], static_cast<uint8_t>(OpCode::SU));
+}
+
+TEST(VM, WatchpointStopsAfterWrite) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 7); // 01
+  prg.push_back(OpCode::LH); // 02
+  prg.push_back((uint16_t) 1000); // 03
+  prg.push_back(OpCode::SB); // 05
+  prg.push_back(OpCode::LB); // 06
+  prg.push_back((uint8_t) 8); // 07
+  prg.push_back(OpCode::LH); // 08
+  prg.push_back((uint16_t) 1100); // 09
+  prg.push_back(OpCode::SW); // 11
+  prg.push_back(OpCode::HS); // 12
+  auto vm = loaded_vm(prg);
+  auto const &[set_err, _1] = vm.set_watchpoint(1102, 4);
+  ASSERT_EQ(set_err, ZError::None);
+
+  auto const &[err, _2] = vm.run();
+  ASSERT_EQ(err, ZError::Watchpoint);
+  ASSERT_EQ(vm.get_watchpoint_addr(), 1102);
+  auto const &ss = vm.snapshot();
+  ASSERT_EQ(ss.get_cores()[0].get_ip(), 12);
+  ASSERT_EQ(ss.get_mem().get_arr()[1000], 7);
+  ASSERT_EQ(ss.get_mem().get_arr()[1100], 8);
+
+  auto const &[resumed_err, _3] = vm.run();
+  ASSERT_EQ(resumed_err, ZError::SystemHalt);
+  auto const &[clear_err, _4] = vm.clear_watchpoint(1102, 4);
+  ASSERT_EQ(clear_err, ZError::None);
+}
+
+TEST(VM, SegmentTranslatesAndIsolates) {
+  program prg;
+  prg.push_back(OpCode::HS); // 00
+  auto vm = loaded_vm(prg);
+  // The tenant at 1000: stores 9 at its address 20, then reads its address 100 past its segment.
+  const uint8_t tenant[] = {
+      static_cast<uint8_t>(OpCode::LB), 9,
+      static_cast<uint8_t>(OpCode::LB), 20,
+      static_cast<uint8_t>(OpCode::SB),
+      static_cast<uint8_t>(OpCode::LB), 100,
+      static_cast<uint8_t>(OpCode::FB),
+  };
+  vm.write_memory(1000, tenant, sizeof(tenant));
+  auto const &[set_err, _1] = vm.set_segment(0, 1000, 64);
+  ASSERT_EQ(set_err, ZError::None);
+  auto const &[bad_err, _2] = vm.set_segment(0, MEMORY_SIZE - 10, 64);
+  ASSERT_EQ(bad_err, ZError::IllegalMemoryAddress);
+
+  auto const &[err, _3] = vm.run();
+  ASSERT_EQ(err, ZError::IllegalMemoryAddress);
+  auto const &ss = vm.snapshot();
+  ASSERT_EQ(ss.get_mem().get_arr()[1020], 9);
+  ASSERT_EQ(ss.get_mem().get_arr()[20], 0);
+  ASSERT_EQ(ss.get_cores()[0].get_ip(), 7);
+}
+
+TEST(VM, SegmentEndHalts) {
+  program prg;
+  prg.push_back(OpCode::NO); // 00
+  prg.push_back(OpCode::NO); // 01
+  prg.push_back(OpCode::NO); // 02
+  auto vm = loaded_vm(prg);
+  vm.set_segment(0, 0, 2);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  ASSERT_EQ(vm.snapshot().get_cores()[0].get_ip(), 2);
+}
+
+TEST(VM, HeapReusesFreedBlocks) {
+  program prg;
+  prg.push_back(OpCode::LH); // 00
+  prg.push_back((uint16_t) 2000); // 01
+  prg.push_back(OpCode::LH); // 03
+  prg.push_back((uint16_t) 256); // 04
+  prg.push_back(OpCode::LB); // 06
+  prg.push_back((uint8_t) 0); // 07
+  prg.push_back(OpCode::HP); // 08
+  prg.push_back(OpCode::LB); // 09
+  prg.push_back((uint8_t) 10); // 10
+  prg.push_back(OpCode::AL); // 11
+  prg.push_back(OpCode::DU); // 12
+  prg.push_back(OpCode::FR); // 13
+  prg.push_back(OpCode::LB); // 14
+  prg.push_back((uint8_t) 12); // 15
+  prg.push_back(OpCode::AL); // 16
+  prg.push_back(OpCode::DU); // 17
+  prg.push_back(OpCode::FR); // 18
+  prg.push_back(OpCode::FR); // 19
+  auto vm = loaded_vm(prg);
+  auto const &[err, _] = vm.run();
+  // The second block reuses the first, freeing it twice fails.
+  ASSERT_EQ(err, ZError::IllegalMemoryAddress);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 19);
+  ASSERT_EQ(vm.get_heap_used(), 16);
+}
+
+TEST(VM, HeapRejectsForgedFreeLists) {
+  program prg;
+  prg.push_back(OpCode::LH); // 00
+  prg.push_back((uint16_t) 2000); // 01
+  prg.push_back(OpCode::LH); // 03
+  prg.push_back((uint16_t) 256); // 04
+  prg.push_back(OpCode::LB); // 06
+  prg.push_back((uint8_t) 0); // 07
+  prg.push_back(OpCode::HP); // 08
+  prg.push_back(OpCode::LB); // 09
+  prg.push_back((uint8_t) 10); // 10
+  prg.push_back(OpCode::AL); // 11
+  prg.push_back(OpCode::FR); // 12
+  prg.push_back(OpCode::LH); // 13
+  prg.push_back((uint16_t) 60000); // 14
+  prg.push_back(OpCode::LH); // 16
+  prg.push_back((uint16_t) 2004); // 17
+  prg.push_back(OpCode::SW); // 19
+  prg.push_back(OpCode::LB); // 20
+  prg.push_back((uint8_t) 10); // 21
+  prg.push_back(OpCode::AL); // 22
+  prg.push_back(OpCode::LB); // 23
+  prg.push_back((uint8_t) 10); // 24
+  prg.push_back(OpCode::AL); // 25
+  auto vm = loaded_vm(prg);
+  auto const &[err, _] = vm.run();
+  // The freed block is reused, the next pointer written over it isn`t followed.
+  ASSERT_EQ(err, ZError::IllegalMemoryAddress);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 25);
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{2004u});
+  ASSERT_EQ(vm.get_heap_used(), 16);
+}
+
+TEST(VM, HeapArenaResets) {
+  program prg;
+  prg.push_back(OpCode::LB); // 00
+  prg.push_back((uint8_t) 10); // 01
+  prg.push_back(OpCode::AL); // 02
+  prg.push_back(OpCode::AR); // 03
+  prg.push_back(OpCode::LB); // 04
+  prg.push_back((uint8_t) 10); // 05
+  prg.push_back(OpCode::AL); // 06
+  prg.push_back(OpCode::LB); // 07
+  prg.push_back((uint8_t) 8); // 08
+  prg.push_back(OpCode::AL); // 09
+  auto vm = loaded_vm(prg);
+  auto const &[set_err, _1] = vm.set_heap(2000, 16, true);
+  ASSERT_EQ(set_err, ZError::None);
+  auto const &[bad_err, _2] = vm.set_heap(MEMORY_SIZE - 8, 16, true);
+  ASSERT_EQ(bad_err, ZError::IllegalMemoryAddress);
+
+  auto const &[err, _3] = vm.run();
+  ASSERT_EQ(err, ZError::OutOfMemory);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 9);
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{2000u});
+  ASSERT_EQ(stack_pop(core.get_data(), 1), Cell{2000u});
+}
+
+TEST(VM, HeapStaysInItsSegment) {
+  program prg;
+  prg.push_back(OpCode::LH); // 00
+  prg.push_back((uint16_t) 2000); // 01
+  prg.push_back(OpCode::LH); // 03
+  prg.push_back((uint16_t) 1024); // 04
+  prg.push_back(OpCode::LB); // 06
+  prg.push_back((uint8_t) 0); // 07
+  prg.push_back(OpCode::HP); // 08
+  prg.push_back(OpCode::LB); // 09
+  prg.push_back((uint8_t) 16); // 10
+  prg.push_back(OpCode::AL); // 11
+  prg.push_back(OpCode::LB); // 12
+  prg.push_back((uint8_t) 0); // 13
+  prg.push_back(OpCode::LB); // 14
+  prg.push_back((uint8_t) 1); // 15
+  prg.push_back(OpCode::IC); // 16
+  prg.push_back(OpCode::LB); // 17
+  prg.push_back((uint8_t) 1); // 18
+  prg.push_back(OpCode::AC); // 19
+  prg.push_back(OpCode::LB); // 20
+  prg.push_back((uint8_t) 20); // 21
+  prg.push_back(OpCode::JU); // 22
+  auto vm = loaded_vm(prg);
+  // Core 1 runs its own program in a segment that doesn`t hold core 0`s heap.
+  const uint8_t other[] = {
+      static_cast<uint8_t>(OpCode::LB), 16,
+      static_cast<uint8_t>(OpCode::AL),
+      static_cast<uint8_t>(OpCode::HS),
+  };
+  vm.write_memory(30000, other, sizeof(other));
+  auto const &[seg_err, _1] = vm.set_segment(1, 30000, 10000);
+  ASSERT_EQ(seg_err, ZError::None);
+
+  auto const &[err, _2] = vm.run_for(1000);
+  ASSERT_EQ(err, ZError::IllegalMemoryAddress);
+  auto core = vm.snapshot().get_cores()[1];
+  ASSERT_EQ(core.get_ip(), 2);
+  // Only core 0`s block, 16 bytes and a header, was allocated.
+  ASSERT_EQ(vm.get_heap_used(), 32);
+}
+
+TEST(VM, DataStackSpillsIntoMemory) {
+  program prg;
+  for (uint8_t i = 1; i <= 40; ++i) {
+    prg.push_back(OpCode::LB);
+    prg.push_back(i);
+  }
+  for (int i = 0; i < 39; ++i) {
+    prg.push_back(OpCode::AD);
+  }
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+  auto const &[overflow_err, _1] = vm.run();
+  ASSERT_EQ(overflow_err, ZError::DataStackOverflow);
+
+  vm = loaded_vm(prg);
+  auto const &[set_err, _2] = vm.set_stack_spill(0, 1000, 64, 0, 0);
+  ASSERT_EQ(set_err, ZError::None);
+  auto const &[bad_err, _3] = vm.set_stack_spill(0, MEMORY_SIZE - 8, 64, 0, 0);
+  ASSERT_EQ(bad_err, ZError::IllegalMemoryAddress);
+  vm.set_stack_spill(0, 1000, 64, 0, 0);
+  auto const &[err, _4] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto data = vm.snapshot().get_cores()[0].get_data();
+  ASSERT_EQ(data.get_top(), 1);
+  ASSERT_EQ(stack_pop(data, 0), Cell{820});
+}
+
+TEST(VM, AddressStackSpillsIntoMemory) {
+  program prg;
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 7);
+  for (int i = 0; i < 150; ++i) {
+    prg.push_back(OpCode::DU);
+    prg.push_back(OpCode::PU);
+  }
+  for (int i = 0; i < 150; ++i) {
+    prg.push_back(OpCode::PO);
+    prg.push_back(OpCode::DR);
+  }
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+  vm.set_stack_spill(0, 0, 0, 2000, 32);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_addrs().get_top(), 0);
+  ASSERT_EQ(core.get_data().get_top(), 1);
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{7});
+}
+
+TEST(VM, ImmediateBranchesWork) {
+  program prg;
+  prg.push_back(OpCode::CI); // 00
+  prg.push_back(OpCode::NO); // 01
+  prg.push_back(OpCode::NO); // 02
+  prg.push_back(OpCode::NO); // 03
+  prg.push_back((uint32_t) 28); // 04
+  prg.push_back(OpCode::LB); // 08
+  prg.push_back((uint8_t) 0); // 09
+  prg.push_back(OpCode::JT); // 10
+  prg.push_back(OpCode::NO); // 11
+  prg.push_back(OpCode::NO); // 12
+  prg.push_back(OpCode::NO); // 13
+  prg.push_back((uint32_t) 100); // 14
+  prg.push_back(OpCode::JI); // 18
+  prg.push_back(OpCode::NO); // 19
+  prg.push_back(OpCode::NO); // 20
+  prg.push_back(OpCode::NO); // 21
+  prg.push_back((uint32_t) 31); // 22
+  prg.push_back(OpCode::NO); // 26
+  prg.push_back(OpCode::NO); // 27
+  prg.push_back(OpCode::LB); // 28
+  prg.push_back((uint8_t) 5); // 29
+  prg.push_back(OpCode::RE); // 30
+  prg.push_back(OpCode::HS); // 31
+  auto vm = loaded_vm(prg);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 31);
+  ASSERT_EQ(core.get_data().get_top(), 1);
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{5});
+  ASSERT_EQ(core.get_addrs().get_top(), 0);
+}
+
+TEST(VM, RelativeImmediateCallWorks) {
+  program prg;
+  prg.push_back(OpCode::JI); // 00
+  prg.push_back(OpCode::NO); // 01
+  prg.push_back(OpCode::NO); // 02
+  prg.push_back(OpCode::NO); // 03
+  prg.push_back((uint32_t) 11); // 04
+  prg.push_back(OpCode::LB); // 08
+  prg.push_back((uint8_t) 9); // 09
+  prg.push_back(OpCode::RE); // 10
+  prg.push_back(OpCode::LB); // 11
+  prg.push_back((uint8_t) 0); // 12
+  prg.push_back(OpCode::NT); // 13
+  prg.push_back(OpCode::RL); // 14
+  prg.push_back(OpCode::CT); // 15
+  prg.push_back(OpCode::NO); // 16
+  prg.push_back(OpCode::NO); // 17
+  prg.push_back(OpCode::NO); // 18
+  prg.push_back((uint32_t) -7); // 19
+  prg.push_back(OpCode::HS); // 23
+  auto vm = loaded_vm(prg);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(core.get_ip(), 23);
+  ASSERT_EQ(core.get_data().get_top(), 1);
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{9});
+}
+
+TEST(VM, CreateLoadsAndMovesWithoutCopyingMemory) {
+  const uint8_t prg[] = {static_cast<uint8_t>(OpCode::LB), 42, static_cast<uint8_t>(OpCode::HS)};
+  auto created = VM::create(prg, sizeof(prg));
+  ASSERT_EQ(std::get<0>(created), ZError::None);
+  const auto data = std::get<1>(created).memory_data();
+
+  auto vm = std::move(std::get<1>(created));
+  ASSERT_EQ(vm.memory_data(), data);
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  ASSERT_EQ(stack_pop(vm.snapshot().get_cores()[0].get_data(), 0), Cell{42});
+
+  auto copy = vm;
+  ASSERT_NE(copy.memory_data(), vm.memory_data());
+  ASSERT_EQ(copy.memory_data()[1], 42);
+
+  std::vector<uint8_t> too_big(MEMORY_SIZE + 1);
+  ASSERT_EQ(std::get<0>(VM::create(too_big.data(), too_big.size())), ZError::IllegalMemoryAddress);
+}
+
+TEST(VM, CopyBlockHandlesOverlap) {
+  for (const uint8_t len : {uint8_t{8}, uint8_t{100}}) {
+    program prg;
+    prg.push_back(OpCode::LH); // 00
+    prg.push_back((uint16_t) 1000); // 01
+    prg.push_back(OpCode::LH); // 03
+    prg.push_back((uint16_t) 1003); // 04
+    prg.push_back(OpCode::LB); // 06
+    prg.push_back(len); // 07
+    prg.push_back(OpCode::CP); // 08
+    prg.push_back(OpCode::LH); // 09
+    prg.push_back((uint16_t) 1003); // 10
+    prg.push_back(OpCode::LH); // 12
+    prg.push_back((uint16_t) 1000); // 13
+    prg.push_back(OpCode::LB); // 15
+    prg.push_back(len); // 16
+    prg.push_back(OpCode::CP); // 17
+    prg.push_back(OpCode::HS); // 18
+    auto vm = loaded_vm(prg);
+    std::vector<uint8_t> bytes(len);
+    for (size_t i = 0; i < len; ++i) {
+      bytes[i] = static_cast<uint8_t>(i + 1);
+    }
+    vm.write_memory(1000, bytes.data(), bytes.size());
+
+    auto const &[err, _] = vm.run();
+    ASSERT_EQ(err, ZError::SystemHalt);
+    // Shifted forward and back again.
+    std::vector<uint8_t> out(len);
+    vm.read_memory(1000, out.data(), out.size());
+    ASSERT_EQ(out, bytes);
+    std::vector<uint8_t> tail(3);
+    vm.read_memory(1000 + len, tail.data(), tail.size());
+    ASSERT_EQ(tail, std::vector<uint8_t>(bytes.end() - 3, bytes.end()));
+  }
+}
+
+TEST(VM, SortAndBinarySearchWork) {
+  for (const int32_t len : {5, 300}) {
+    program prg;
+    prg.push_back(OpCode::LH); // 00
+    prg.push_back((uint16_t) 2000); // 01
+    prg.push_back(OpCode::LH); // 03
+    prg.push_back((uint16_t) len); // 04
+    prg.push_back(OpCode::SO); // 06
+    prg.push_back(OpCode::LH); // 07
+    prg.push_back((uint16_t) 2000); // 08
+    prg.push_back(OpCode::LH); // 10
+    prg.push_back((uint16_t) len); // 11
+    prg.push_back(OpCode::LB); // 13
+    prg.push_back((uint8_t) 0); // 14
+    prg.push_back(OpCode::BS); // 15
+    prg.push_back(OpCode::HS); // 16
+    auto vm = loaded_vm(prg);
+    // Descending values around 0.
+    std::vector<int32_t> values(len);
+    for (int32_t i = 0; i < len; ++i) {
+      values[i] = (len / 2 - i) * 1000;
+    }
+    vm.write_memory(2000, reinterpret_cast<const uint8_t *>(values.data()), values.size() * 4);
+
+    auto const &[err, _] = vm.run();
+    ASSERT_EQ(err, ZError::SystemHalt);
+    std::vector<int32_t> sorted(len);
+    vm.read_memory(2000, reinterpret_cast<uint8_t *>(sorted.data()), sorted.size() * 4);
+    std::sort(values.begin(), values.end());
+    ASSERT_EQ(sorted, values);
+    auto core = vm.snapshot().get_cores()[0];
+    ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{static_cast<uint32_t>(len - len / 2 - 1)});
+  }
+}
+
+TEST(VM, FloatSortWorks) {
+  program prg;
+  prg.push_back(OpCode::LH); // 00
+  prg.push_back((uint16_t) 2000); // 01
+  prg.push_back(OpCode::LB); // 03
+  prg.push_back((uint8_t) 4); // 04
+  prg.push_back(OpCode::FF); // 05
+  prg.push_back(OpCode::SO); // 06
+  prg.push_back(OpCode::HS); // 07
+  auto vm = loaded_vm(prg);
+  const float values[] = {2.5f, -1.0f, 0.0f, -3.5f};
+  vm.write_memory(2000, reinterpret_cast<const uint8_t *>(values), sizeof(values));
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  float sorted[4];
+  vm.read_memory(2000, reinterpret_cast<uint8_t *>(sorted), sizeof(sorted));
+  ASSERT_EQ(sorted[0], -3.5f);
+  ASSERT_EQ(sorted[1], -1.0f);
+  ASSERT_EQ(sorted[2], 0.0f);
+  ASSERT_EQ(sorted[3], 2.5f);
+}
+
+TEST(VM, HashTableWorks) {
+  program prg;
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 64);
+  prg.push_back(OpCode::HN);
+  for (uint16_t key = 1; key <= 50; ++key) {
+    prg.push_back(OpCode::LH);
+    prg.push_back((uint16_t) 2000);
+    prg.push_back(OpCode::LH);
+    prg.push_back(key);
+    prg.push_back(OpCode::LH);
+    prg.push_back((uint16_t) (key * 3));
+    prg.push_back(OpCode::HA);
+  }
+  // Overwrite 7, delete 8.
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 7);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 99);
+  prg.push_back(OpCode::HA);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 8);
+  prg.push_back(OpCode::HD);
+  for (uint16_t key : {7, 8, 50, 1000}) {
+    prg.push_back(OpCode::LH);
+    prg.push_back((uint16_t) 2000);
+    prg.push_back(OpCode::LH);
+    prg.push_back(key);
+    prg.push_back(OpCode::HL);
+  }
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto core = vm.snapshot().get_cores()[0];
+  auto const &data = core.get_data();
+  ASSERT_EQ(stack_pop(data, 0), Cell{false});
+  ASSERT_EQ(stack_pop(data, 1), Cell{uint32_t{0}});
+  ASSERT_EQ(stack_pop(data, 2), Cell{true});
+  ASSERT_EQ(stack_pop(data, 3), Cell{uint32_t{150}});
+  ASSERT_EQ(stack_pop(data, 4), Cell{false});
+  ASSERT_EQ(stack_pop(data, 5), Cell{uint32_t{0}});
+  ASSERT_EQ(stack_pop(data, 6), Cell{true});
+  ASSERT_EQ(stack_pop(data, 7), Cell{uint32_t{99}});
+  ASSERT_EQ(stack_pop(data, 8), Cell{true});
+  // The header holds the capacity and the count.
+  uint32_t header[2];
+  vm.read_memory(2000, reinterpret_cast<uint8_t *>(header), sizeof(header));
+  ASSERT_EQ(header[0], 64u);
+  ASSERT_EQ(header[1], 49u);
+}
+
+TEST(VM, HashTableRejectsBadCapacityAndOverflow) {
+  program bad;
+  bad.push_back(OpCode::LH);
+  bad.push_back((uint16_t) 2000);
+  bad.push_back(OpCode::LB);
+  bad.push_back((uint8_t) 24);
+  bad.push_back(OpCode::HN);
+  bad.push_back(OpCode::HS);
+  auto bad_vm = loaded_vm(bad);
+  ASSERT_EQ(std::get<0>(bad_vm.run()), ZError::IllegalOperand);
+
+  program full;
+  full.push_back(OpCode::LH);
+  full.push_back((uint16_t) 2000);
+  full.push_back(OpCode::LB);
+  full.push_back((uint8_t) 16);
+  full.push_back(OpCode::HN);
+  for (uint8_t key = 1; key <= 15; ++key) {
+    full.push_back(OpCode::LH);
+    full.push_back((uint16_t) 2000);
+    full.push_back(OpCode::LB);
+    full.push_back(key);
+    full.push_back(OpCode::LB);
+    full.push_back(key);
+    full.push_back(OpCode::HA);
+  }
+  full.push_back(OpCode::HS);
+  auto full_vm = loaded_vm(full);
+  ASSERT_EQ(std::get<0>(full_vm.run()), ZError::OutOfMemory);
+  uint32_t count;
+  full_vm.read_memory(2004, reinterpret_cast<uint8_t *>(&count), sizeof(count));
+  ASSERT_EQ(count, 14u);
+}
+
+TEST(VM, HashTableSurvivesChurn) {
+  // Hold a 64 slot table at 40 keys under random inserts and deletes, so deleted slots pile up.
+  program prg;
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 60000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 64);
+  prg.push_back(OpCode::HN);
+  std::vector<uint16_t> live;
+  uint32_t seed = 1;
+  for (int op = 0; op < 2000; ++op) {
+    seed = seed * 1103515245u + 12345u;
+    const auto pick = static_cast<uint16_t>(seed >> 16);
+    prg.push_back(OpCode::LH);
+    prg.push_back((uint16_t) 60000);
+    if (live.size() < 40) {
+      const auto key = static_cast<uint16_t>(pick | 1);
+      if (std::find(live.begin(), live.end(), key) == live.end()) {
+        live.push_back(key);
+      }
+      prg.push_back(OpCode::LH);
+      prg.push_back(key);
+      prg.push_back(OpCode::LB);
+      prg.push_back((uint8_t) 1);
+      prg.push_back(OpCode::HA);
+    } else {
+      const auto at = live.begin() + pick % live.size();
+      prg.push_back(OpCode::LH);
+      prg.push_back(*at);
+      prg.push_back(OpCode::HD);
+      prg.push_back(OpCode::DR);
+      live.erase(at);
+    }
+  }
+  // And whether every live key is found.
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 0);
+  prg.push_back(OpCode::NT);
+  for (auto key: live) {
+    prg.push_back(OpCode::LH);
+    prg.push_back((uint16_t) 60000);
+    prg.push_back(OpCode::LH);
+    prg.push_back(key);
+    prg.push_back(OpCode::HL);
+    prg.push_back(OpCode::SP);
+    prg.push_back(OpCode::DR);
+    prg.push_back(OpCode::AN);
+  }
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{true});
+  uint32_t count;
+  vm.read_memory(60004, reinterpret_cast<uint8_t *>(&count), sizeof(count));
+  ASSERT_EQ(count, live.size());
+}
+
+TEST(HashTable, RehashDropsForgedDuplicates) {
+  // A 16 slot table ending where the region ends, followed by bytes it must not touch.
+  const size_t addr = 1000;
+  const size_t limit = addr + HASH_TABLE_HEADER_SIZE + 16 + 16 * 8;
+  auto memory = Memory{};
+  const std::array<uint8_t, 8> guard = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+  memory.write_block(limit, guard.data(), guard.size());
+  ASSERT_EQ(std::get<0>(HashTable::init(memory, addr, 16, limit)), ZError::None);
+  ASSERT_EQ(std::get<0>(HashTable::insert(memory, addr, 7, 70, limit)), ZError::None);
+  std::array<uint8_t, 16> ctrl{};
+  memory.read_block(addr + HASH_TABLE_HEADER_SIZE, ctrl.data(), ctrl.size());
+  const auto tag = *std::find_if(ctrl.begin(), ctrl.end(), [](uint8_t byte) { return byte < 0x80; });
+
+  // Store key 7 twice and use up the other slots but two with deleted keys, so the next insert rehashes.
+  ctrl.fill(0xFE);
+  ctrl[0] = 0x80;
+  ctrl[1] = 0x80;
+  ctrl[2] = tag;
+  ctrl[3] = tag;
+  memory.write_block(addr + HASH_TABLE_HEADER_SIZE, ctrl.data(), ctrl.size());
+  const uint32_t slots[] = {7, 70, 7, 71};
+  memory.write_block(addr + HASH_TABLE_HEADER_SIZE + 16 + 2 * 8, reinterpret_cast<const uint8_t *>(slots),
+                     sizeof(slots));
+  memory.write_bytes<4>(addr + 4, Cell{2u});
+  memory.write_bytes<4>(addr + 8, Cell{14u});
+
+  ASSERT_EQ(std::get<0>(HashTable::insert(memory, addr, 8, 80, limit)), ZError::None);
+  std::array<uint8_t, 8> after{};
+  memory.read_block(limit, after.data(), after.size());
+  ASSERT_EQ(after, guard);
+  ASSERT_EQ(std::get<1>(HashTable::lookup(memory, addr, 8, limit)).value, 80u);
+  ASSERT_EQ(std::get<1>(memory.read_bytes<4>(addr + 4)), Cell{2u});
+  ASSERT_EQ(std::get<1>(memory.read_bytes<4>(addr + 8)), Cell{2u});
+  // Only one copy of the key is left.
+  ASSERT_TRUE(std::get<1>(HashTable::remove(memory, addr, 7, limit)));
+  ASSERT_FALSE(std::get<1>(HashTable::lookup(memory, addr, 7, limit)).found);
+}
+
+TEST(VM, DspKernelsWork) {
+  program prg;
+  // Signed dot product of 20 words, past a full set of lanes.
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2000);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2100);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 20);
+  prg.push_back(OpCode::DP);
+  // Signed 2x3 by 3x2 matrix product.
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 3000);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 3100);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 3200);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 2);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 3);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 2);
+  prg.push_back(OpCode::MM);
+  // Float 3 tap filter over a window of 7 samples.
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 4000);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 4100);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 4200);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 3);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 5);
+  prg.push_back(OpCode::FF);
+  prg.push_back(OpCode::FI);
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+  std::vector<int32_t> a(20), b(20);
+  int32_t dot = 0;
+  for (int32_t i = 0; i < 20; ++i) {
+    a[i] = i - 7;
+    b[i] = 3 * i + 1;
+    dot += a[i] * b[i];
+  }
+  vm.write_memory(2000, reinterpret_cast<const uint8_t *>(a.data()), a.size() * 4);
+  vm.write_memory(2100, reinterpret_cast<const uint8_t *>(b.data()), b.size() * 4);
+  const int32_t lhs[] = {1, -2, 3, 4, 5, -6};
+  const int32_t rhs[] = {7, 8, 9, -10, 11, 12};
+  vm.write_memory(3100, reinterpret_cast<const uint8_t *>(lhs), sizeof(lhs));
+  vm.write_memory(3200, reinterpret_cast<const uint8_t *>(rhs), sizeof(rhs));
+  const float window[] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+  const float taps[] = {0.5f, 0.25f, 2.0f};
+  vm.write_memory(4100, reinterpret_cast<const uint8_t *>(window), sizeof(window));
+  vm.write_memory(4200, reinterpret_cast<const uint8_t *>(taps), sizeof(taps));
+
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  auto core = vm.snapshot().get_cores()[0];
+  ASSERT_EQ(stack_pop(core.get_data(), 0), Cell{dot});
+  int32_t product[4];
+  vm.read_memory(3000, reinterpret_cast<uint8_t *>(product), sizeof(product));
+  ASSERT_EQ(product[0], 1 * 7 - 2 * 9 + 3 * 11);
+  ASSERT_EQ(product[1], 1 * 8 + 2 * 10 + 3 * 12);
+  ASSERT_EQ(product[2], 4 * 7 + 5 * 9 - 6 * 11);
+  ASSERT_EQ(product[3], 4 * 8 - 5 * 10 - 6 * 12);
+  float filtered[5];
+  vm.read_memory(4000, reinterpret_cast<uint8_t *>(filtered), sizeof(filtered));
+  for (int n = 0; n < 5; ++n) {
+    ASSERT_EQ(filtered[n], 0.5f * window[n + 2] + 0.25f * window[n + 1] + 2.0f * window[n]);
+  }
+}
+
+TEST(VM, DspKernelsCheckOperands) {
+  program no_taps;
+  no_taps.push_back(OpCode::LH);
+  no_taps.push_back((uint16_t) 4000);
+  no_taps.push_back(OpCode::LH);
+  no_taps.push_back((uint16_t) 4100);
+  no_taps.push_back(OpCode::LH);
+  no_taps.push_back((uint16_t) 4200);
+  no_taps.push_back(OpCode::LB);
+  no_taps.push_back((uint8_t) 0);
+  no_taps.push_back(OpCode::LB);
+  no_taps.push_back((uint8_t) 5);
+  no_taps.push_back(OpCode::FI);
+  no_taps.push_back(OpCode::HS);
+  auto no_taps_vm = loaded_vm(no_taps);
+  ASSERT_EQ(std::get<0>(no_taps_vm.run()), ZError::IllegalOperand);
+
+  program too_large;
+  too_large.push_back(OpCode::LH);
+  too_large.push_back((uint16_t) 2000);
+  too_large.push_back(OpCode::LH);
+  too_large.push_back((uint16_t) 2100);
+  too_large.push_back(OpCode::LW);
+  too_large.push_back(OpCode::NO);
+  too_large.push_back(OpCode::NO);
+  too_large.push_back(OpCode::NO);
+  too_large.push_back((uint32_t) 0x40000000);
+  too_large.push_back(OpCode::DP);
+  too_large.push_back(OpCode::HS);
+  auto too_large_vm = loaded_vm(too_large);
+  ASSERT_EQ(std::get<0>(too_large_vm.run()), ZError::IllegalMemoryAddress);
+}
+
+TEST(VM, FourierTransformWorks) {
+  program prg;
+  // Forward transform at 2000.
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 16);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 0);
+  prg.push_back(OpCode::FT);
+  // Forward and inverse transform at 3000.
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 3000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 16);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 0);
+  prg.push_back(OpCode::FT);
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 3000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 16);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 0);
+  prg.push_back(OpCode::NT);
+  prg.push_back(OpCode::FT);
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+  std::vector<float> signal(32);
+  for (int n = 0; n < 16; ++n) {
+    signal[n * 2] = std::cos(0.7f * n) + 0.25f * n;
+    signal[n * 2 + 1] = std::sin(1.3f * n);
+  }
+  vm.write_memory(2000, reinterpret_cast<const uint8_t *>(signal.data()), signal.size() * 4);
+  vm.write_memory(3000, reinterpret_cast<const uint8_t *>(signal.data()), signal.size() * 4);
+
+  auto const &[err, _] = vm.run();
+  ASSERT_EQ(err, ZError::SystemHalt);
+  std::vector<float> spectrum(32);
+  vm.read_memory(2000, reinterpret_cast<uint8_t *>(spectrum.data()), spectrum.size() * 4);
+  for (int k = 0; k < 16; ++k) {
+    double re = 0;
+    double im = 0;
+    for (int n = 0; n < 16; ++n) {
+      const auto angle = -2.0 * M_PI * k * n / 16;
+      re += signal[n * 2] * std::cos(angle) - signal[n * 2 + 1] * std::sin(angle);
+      im += signal[n * 2] * std::sin(angle) + signal[n * 2 + 1] * std::cos(angle);
+    }
+    ASSERT_NEAR(spectrum[k * 2], re, 1e-4);
+    ASSERT_NEAR(spectrum[k * 2 + 1], im, 1e-4);
+  }
+  std::vector<float> round_trip(32);
+  vm.read_memory(3000, reinterpret_cast<uint8_t *>(round_trip.data()), round_trip.size() * 4);
+  for (size_t i = 0; i < signal.size(); ++i) {
+    ASSERT_NEAR(round_trip[i], signal[i], 1e-5);
+  }
+}
+
+TEST(VM, FourierTransformRejectsOtherSizes) {
+  program prg;
+  prg.push_back(OpCode::LH);
+  prg.push_back((uint16_t) 2000);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 12);
+  prg.push_back(OpCode::LB);
+  prg.push_back((uint8_t) 0);
+  prg.push_back(OpCode::FT);
+  prg.push_back(OpCode::HS);
+  auto vm = loaded_vm(prg);
+  ASSERT_EQ(std::get<0>(vm.run()), ZError::IllegalOperand);
+}